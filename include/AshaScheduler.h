@@ -0,0 +1,123 @@
+/*
+ * (c) Copyright bitrate16 (GPLv3.0) 2020
+ */
+
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <mutex>
+#include <condition_variable>
+
+namespace NNSpace {
+
+	// Asynchronous successive halving (ASHA) scheduler.
+	// Candidates start at rung 0 and are promoted to the next rung as soon as they are
+	//  in the top 1 / eta of the candidates reported at their rung, without waiting
+	//  for the whole rung to complete. Candidates that are never promoted are dropped.
+	// Promotions are never taken back, so later reports may promote more candidates than
+	//  synchronous halving keeps and the total amount of training can exceed its schedule.
+	// Thread-safe, workers call next() to get job and report() when it is done.
+	class AshaScheduler {
+
+	public:
+
+		// Single unit of work: train candidate id on rung
+		struct Job {
+			int id;
+			int rung;
+		};
+
+	private:
+
+		int candidates;
+		int rungs;
+		int eta;
+
+		// Next candidate to start at rung 0
+		int next_candidate = 0;
+		// Amount of jobs in progress
+		int running = 0;
+		// Reported (error, id) of each rung
+		std::vector<std::vector<std::pair<double, int>>> results;
+		// Promotion flags of each rung
+		std::vector<std::vector<char>> promoted;
+
+		std::mutex lock;
+		std::condition_variable cv;
+
+		// Find next job, top rungs first
+		bool find(Job& job) {
+			for (int r = rungs - 2; r >= 0; --r) {
+				std::sort(results[r].begin(), results[r].end());
+
+				int top = results[r].size() / eta;
+				for (int i = 0; i < top; ++i)
+					if (!promoted[r][results[r][i].second]) {
+						promoted[r][results[r][i].second] = 1;
+						job = { results[r][i].second, r + 1 };
+						return 1;
+					}
+			}
+
+			if (next_candidate < candidates) {
+				job = { next_candidate++, 0 };
+				return 1;
+			}
+
+			return 0;
+		};
+
+	public:
+
+		// candidates - amount of candidates
+		// rungs      - amount of rungs
+		// eta        - reduction factor
+		AshaScheduler(int candidates, int rungs, int eta = 2) : candidates(candidates), rungs(std::max(1, rungs)), eta(std::max(2, eta)) {
+			results.resize(this->rungs);
+			promoted.assign(this->rungs, std::vector<char>(candidates, 0));
+		};
+
+		// Get next job, blocks while jobs in progress may produce new promotions.
+		// Returns 0 when there is no more work.
+		bool next(Job& job) {
+			std::unique_lock<std::mutex> guard(lock);
+
+			while (1) {
+				if (find(job)) {
+					++running;
+					return 1;
+				}
+
+				if (running == 0) {
+					cv.notify_all();
+					return 0;
+				}
+
+				cv.wait(guard);
+			}
+		};
+
+		// Report error value of the completed job, lower is better
+		void report(const Job& job, double error) {
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				results[job.rung].push_back({ error, job.id });
+				--running;
+			}
+
+			cv.notify_all();
+		};
+
+		// Id of the best candidate of the highest reached rung, -1 if nothing was reported
+		int best() {
+			std::lock_guard<std::mutex> guard(lock);
+
+			for (int r = rungs - 1; r >= 0; --r)
+				if (results[r].size())
+					return std::min_element(results[r].begin(), results[r].end())->second;
+
+			return -1;
+		};
+	};
+};
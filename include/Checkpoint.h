@@ -0,0 +1,362 @@
+/*
+ * (c) Copyright bitrate16 (GPLv3.0) 2020
+ */
+
+#pragma once
+
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <future>
+#include <mutex>
+
+#include "MultiLayerNetwork.h"
+#include "Population.h"
+
+// Binary checkpoints of the training state.
+// Snapshot is serialized into memory by the training thread and written to disk in background.
+namespace NNSpace {
+	namespace checkpoint {
+
+		// "NNCK"
+		const uint32_t MAGIC   = 0x4B434E4E;
+		const uint32_t VERSION = 2;
+
+		// Checkpoint content type
+		enum Kind {
+			POPULATION = 1
+		};
+
+		template<typename T>
+		inline void put(std::string& out, const T& v) {
+			out.append(reinterpret_cast<const char*>(&v), sizeof(T));
+		};
+
+		inline void put(std::string& out, const double* v, std::size_t n) {
+			out.append(reinterpret_cast<const char*>(v), n * sizeof(double));
+		};
+
+		// Sequential reader over loaded checkpoint
+		struct reader {
+			const std::string& data;
+			std::size_t pos = 0;
+			bool fail = 0;
+
+			reader(const std::string& data) : data(data) {};
+
+			template<typename T>
+			T get() {
+				T v = T();
+				if (pos + sizeof(T) > data.size()) {
+					fail = 1;
+					return v;
+				}
+
+				std::memcpy(&v, data.data() + pos, sizeof(T));
+				pos += sizeof(T);
+				return v;
+			};
+
+			void get(double* v, std::size_t n) {
+				if (pos + n * sizeof(double) > data.size()) {
+					fail = 1;
+					return;
+				}
+
+				std::memcpy(v, data.data() + pos, n * sizeof(double));
+				pos += n * sizeof(double);
+			};
+		};
+
+		// Append network, weights are stored in row-major order
+		void put_network(std::string& out, const NNSpace::MLNet& net) {
+			put<uint32_t>(out, net.dimensions.size());
+			for (int d : net.dimensions)
+				put<int32_t>(out, d);
+
+			if (net.dimensions.empty())
+				return;
+
+			for (int k = 0; k < net.dimensions.size() - 1; ++k)
+				put<uint32_t>(out, net.activators[k]->getType());
+
+			// Bit 1 marks that mask of each layer follows the weights
+			bool masked = net.masked();
+			put<uint8_t>(out, net.enable_offsets | (masked << 1));
+
+			for (int k = 0; k < net.dimensions.size() - 1; ++k) {
+				if (net.W[k].layout == ROW_MAJOR)
+					put(out, net.W[k].raw(), net.W[k].size());
+				else
+					for (int i = 0; i < net.W[k].rows; ++i)
+						for (int j = 0; j < net.W[k].cols; ++j)
+							put<double>(out, net.W[k].at(i, j));
+
+				put(out, net.offsets[k].data(), net.offsets[k].size());
+			}
+
+			if (masked)
+				for (int k = 0; k < net.dimensions.size(); ++k)
+					for (int i = 0; i < net.dimensions[k]; ++i)
+						put<uint8_t>(out, net.isActive(k, i));
+		};
+
+		// Read network stored by put_network()
+		bool get_network(reader& in, NNSpace::MLNet& net) {
+			uint32_t size = in.get<uint32_t>();
+			if (in.fail || size > (1 << 16))
+				return 0;
+
+			if (size == 0) {
+				NNSpace::MLNet().swap(net);
+				return 1;
+			}
+
+			std::vector<int> dimensions(size);
+			for (auto& d : dimensions) {
+				d = in.get<int32_t>();
+				if (d <= 0)
+					return 0;
+			}
+
+			net.set(dimensions);
+
+			for (int k = 0; k < size - 1; ++k) {
+				uint32_t type = in.get<uint32_t>();
+				delete net.activators[k];
+				net.activators[k] = getActivatorByType((ActivatorType) type);
+			}
+
+			uint8_t flags = in.get<uint8_t>();
+			net.enable_offsets = flags & 1;
+
+			for (int k = 0; k < size - 1; ++k) {
+				if (net.W[k].layout == ROW_MAJOR)
+					in.get(net.W[k].raw(), net.W[k].size());
+				else
+					for (int i = 0; i < net.W[k].rows; ++i)
+						for (int j = 0; j < net.W[k].cols; ++j)
+							net.W[k].at(i, j) = in.get<double>();
+
+				in.get(net.offsets[k].data(), net.offsets[k].size());
+			}
+
+			if (flags & 2)
+				for (int k = 0; k < size; ++k)
+					for (int i = 0; i < dimensions[k]; ++i)
+						if (!in.get<uint8_t>()) {
+							if (k == 0)
+								return 0;
+							net.setActive(k, i, 0);
+						}
+
+			net.sparsify();
+
+			return !in.fail;
+		};
+
+		// Training schedule population state belongs to, resuming with other schedule gives other results
+		struct Schedule {
+			// Amount of startup networks
+			int32_t networks = 0;
+			// Amount of halving rounds (Af)
+			int32_t rounds = 0;
+			// Size of train subset of each epoch
+			int64_t subset_size = 0;
+
+			inline bool operator==(const Schedule& s) const {
+				return networks == s.networks && rounds == s.rounds && subset_size == s.subset_size;
+			};
+
+			inline bool operator!=(const Schedule& s) const { return !(*this == s); };
+		};
+
+		// Serialize population state
+		// schedule   - training schedule
+		// epoch      - next epoch to run
+		// iterations - amount of training iterations done
+		std::string save_population(const NNSpace::Population& pop, const Schedule& schedule, int epoch, unsigned long iterations) {
+			std::string out;
+
+			put<uint32_t>(out, MAGIC);
+			put<uint32_t>(out, VERSION);
+			put<uint32_t>(out, POPULATION);
+			put<int32_t>(out, schedule.networks);
+			put<int32_t>(out, schedule.rounds);
+			put<int64_t>(out, schedule.subset_size);
+			put<int32_t>(out, epoch);
+			put<uint64_t>(out, iterations);
+
+			put<uint32_t>(out, pop.networks.size());
+			put<uint32_t>(out, pop.active.size());
+			for (int id : pop.active)
+				put<int32_t>(out, id);
+
+			put(out, pop.rates.data(),    pop.rates.size());
+			put(out, pop.errors_a.data(), pop.errors_a.size());
+			put(out, pop.errors_b.data(), pop.errors_b.size());
+			put(out, pop.errors_d.data(), pop.errors_d.size());
+
+			for (auto& net : pop.networks)
+				put_network(out, net);
+
+			return out;
+		};
+
+		// Restore population state from file, schedule is set to the one state was saved with
+		// Returns 0 on failture
+		bool load_population(const std::string& path, NNSpace::Population& pop, Schedule& schedule, int& epoch, unsigned long& iterations) {
+			std::ifstream file(path, std::ios::binary);
+			if (!file)
+				return 0;
+
+			std::stringstream ss;
+			ss << file.rdbuf();
+			std::string data = ss.str();
+			reader in(data);
+
+			if (in.get<uint32_t>() != MAGIC || in.get<uint32_t>() != VERSION || in.get<uint32_t>() != POPULATION)
+				return 0;
+
+			Schedule stored;
+			stored.networks    = in.get<int32_t>();
+			stored.rounds      = in.get<int32_t>();
+			stored.subset_size = in.get<int64_t>();
+
+			epoch      = in.get<int32_t>();
+			iterations = in.get<uint64_t>();
+
+			uint32_t count  = in.get<uint32_t>();
+			uint32_t alive  = in.get<uint32_t>();
+			if (in.fail || alive > count)
+				return 0;
+
+			std::vector<NNSpace::MLNet> networks(count);
+			NNSpace::Population state(std::move(networks));
+
+			state.active.resize(alive);
+			for (auto& id : state.active) {
+				id = in.get<int32_t>();
+				if (id < 0 || id >= count)
+					return 0;
+			}
+
+			in.get(state.rates.data(),    count);
+			in.get(state.errors_a.data(), count);
+			in.get(state.errors_b.data(), count);
+			in.get(state.errors_d.data(), count);
+
+			for (auto& net : state.networks)
+				if (!get_network(in, net))
+					return 0;
+
+			if (in.fail)
+				return 0;
+
+			pop      = std::move(state);
+			schedule = stored;
+			return 1;
+		};
+
+		// Writes snapshots to disk in background thread.
+		// File is written to path.tmp and renamed, so existing checkpoint is never corrupted.
+		// Snapshot given while previous one is being written waits in single slot,
+		//  newer snapshot replaces it, so training never waits and the latest state reaches disk.
+		// Failed write is kept until flush() and reported by write_async() and flush().
+		class AsyncWriter {
+
+			std::future<void> pending;
+
+			std::mutex lock;
+			// Background write is in progress
+			bool running = 0;
+			// Latest snapshot waiting for the running write
+			bool queued = 0;
+			std::string queued_path;
+			std::string queued_data;
+			// Any write failed
+			bool failed = 0;
+
+			static bool write(const std::string& path, const std::string& data) {
+				std::string tmp = path + ".tmp";
+
+				{
+					std::ofstream file(tmp, std::ios::binary | std::ios::trunc);
+					if (!file)
+						return 0;
+
+					file.write(data.data(), data.size());
+					if (!file)
+						return 0;
+				}
+
+				return std::rename(tmp.c_str(), path.c_str()) == 0;
+			};
+
+			// Write snapshot and then waiting ones until slot is empty
+			void run(std::string path, std::string data) {
+				while (1) {
+					bool result = write(path, data);
+
+					std::lock_guard<std::mutex> guard(lock);
+					failed |= !result;
+
+					if (!queued) {
+						running = 0;
+						return;
+					}
+
+					path.swap(queued_path);
+					data.swap(queued_data);
+					queued = 0;
+				}
+			};
+
+		public:
+
+			AsyncWriter() {};
+
+			AsyncWriter(const AsyncWriter&) = delete;
+
+			AsyncWriter& operator=(const AsyncWriter&) = delete;
+
+			~AsyncWriter() {
+				flush();
+			};
+
+			// Start writing snapshot, or put it into slot if previous snapshot is still being written.
+			// Returns 0 if any of previous writes failed.
+			bool write_async(const std::string& path, std::string&& data) {
+				std::lock_guard<std::mutex> guard(lock);
+
+				if (running) {
+					queued_path = path;
+					queued_data = std::move(data);
+					queued      = 1;
+					return !failed;
+				}
+
+				// Previous write is done
+				if (pending.valid())
+					pending.get();
+
+				running = 1;
+				pending = std::async(std::launch::async, [this, path, data = std::move(data)]() mutable { run(path, std::move(data)); });
+				return !failed;
+			};
+
+			// Wait for pending writes, returns 0 if any write failed
+			bool flush() {
+				if (pending.valid())
+					pending.get();
+
+				std::lock_guard<std::mutex> guard(lock);
+				return !failed;
+			};
+		};
+	};
+};
@@ -0,0 +1,404 @@
+/*
+ * (c) Copyright bitrate16 (GPLv3.0) 2020
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <fstream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "SetFile.h"
+#include "TextFormat.h"
+
+// Streaming of training samples from files by fixed-size chunks.
+// Only a few chunks are kept in memory, so sets larger than memory can be used for training.
+namespace NNSpace {
+
+	// Sequential source of samples
+	class SampleSource {
+
+	protected:
+
+		// Set if read failed before the end of source
+		bool error = 0;
+
+	public:
+
+		virtual ~SampleSource() {};
+
+		// Size of single input
+		virtual int input_size() const = 0;
+
+		// Size of single output
+		virtual int output_size() const = 0;
+
+		// Total amount of samples
+		virtual std::size_t size() const = 0;
+
+		// Read up to count next samples into rows of inputs and outputs.
+		// Returns amount of samples read, 0 at the end.
+		// On error returns samples read before it and sets failed(), next reads return 0.
+		virtual int read(double* inputs, double* outputs, int count) = 0;
+
+		// Returns 1 if read failed, source ended before all samples were read
+		inline bool failed() const { return error; };
+	};
+
+	// Approximation set file, text or binary (see SetFile.h), output is single Y value
+	class SetSource : public SampleSource {
+
+		std::ifstream is;
+		text::Reader* text = nullptr;
+		bool binary = 0;
+		std::size_t count = 0;
+		int x_size = 0;
+		// Index of next sample
+		std::size_t pos = 0;
+		// Column buffer of binary format
+		std::vector<double> column;
+
+	public:
+
+		SetSource() {};
+
+		SetSource(const std::string& path) {
+			open(path);
+		};
+
+		SetSource(const SetSource&) = delete;
+
+		SetSource& operator=(const SetSource&) = delete;
+
+		~SetSource() {
+			delete text;
+		};
+
+		// Open set file, format is detected by file header
+		// Returns 0 on failture
+		bool open(const std::string& path) {
+			delete text;
+			text  = nullptr;
+			pos   = 0;
+			error = 0;
+
+			binary = setfile::is_binary(path);
+
+			if (binary) {
+				setfile::MappedSet map;
+				if (!map.open(path))
+					return 0;
+
+				count  = map.count;
+				x_size = map.x_size;
+			}
+
+			is.close();
+			is.clear();
+			is.open(path, std::ios::binary);
+			if (!is)
+				return 0;
+
+			if (!binary) {
+				int c = 0;
+				text = new text::Reader(is);
+				text->get(c);
+				text->get(x_size);
+
+				if (text->fail || c < 0 || x_size < 0)
+					return 0;
+
+				count = c;
+			}
+
+			return 1;
+		};
+
+		int input_size() const { return x_size; };
+
+		int output_size() const { return 1; };
+
+		std::size_t size() const { return count; };
+
+		int read(double* inputs, double* outputs, int n) {
+			if (pos + n > count)
+				n = count - pos;
+			if (n <= 0 || error)
+				return 0;
+
+			if (binary) {
+				column.resize(n);
+
+				for (int c = 0; c <= x_size; ++c) {
+					is.seekg(setfile::column(count, c) + pos * sizeof(double));
+					is.read(reinterpret_cast<char*>(column.data()), n * sizeof(double));
+
+					// Keep samples that are complete in every column
+					if (!is) {
+						is.clear();
+						error = 1;
+						n = std::min<std::size_t>(n, is.gcount() / sizeof(double));
+					}
+
+					if (c < x_size)
+						for (int b = 0; b < n; ++b)
+							inputs[(std::size_t) b * x_size + c] = column[b];
+					else
+						std::copy(column.begin(), column.begin() + n, outputs);
+				}
+			} else {
+				for (int b = 0; b < n; ++b) {
+					for (int k = 0; k < x_size; ++k)
+						text->get(inputs[(std::size_t) b * x_size + k]);
+					text->get(outputs[b]);
+
+					// Drop incomplete sample
+					if (text->fail) {
+						error = 1;
+						n = b;
+						break;
+					}
+				}
+			}
+
+			pos += n;
+			return n;
+		};
+	};
+
+	// MNIST images and labels files (as in mnist::read_dataset), images are normalized to [0, 1],
+	//  output is one-hot vector of 10 values
+	class MnistSource : public SampleSource {
+
+		std::ifstream images;
+		std::ifstream labels;
+		int image_size = 0;
+		std::size_t from = 0;
+		std::size_t count = 0;
+		std::size_t pos = 0;
+		std::vector<uint8_t> pixels;
+		std::vector<uint8_t> digits;
+
+		inline static uint32_t read_header(std::ifstream& is) {
+			unsigned char b[4] = { 0, 0, 0, 0 };
+			is.read(reinterpret_cast<char*>(b), 4);
+			return ((uint32_t) b[0] << 24) | ((uint32_t) b[1] << 16) | ((uint32_t) b[2] << 8) | b[3];
+		};
+
+	public:
+
+		MnistSource() {};
+
+		// Stream training images [offset, offset + size) from MNIST directory, size -1 for all
+		bool open(const std::string& dir, int offset = 0, int size = -1) {
+			return open(dir + "/train-images.idx3-ubyte", dir + "/train-labels.idx1-ubyte", offset, size);
+		};
+
+		// Stream images [offset, offset + size) of the given files, size -1 for all
+		bool open(const std::string& images_path, const std::string& labels_path, int offset, int size) {
+			images.close();
+			labels.close();
+			images.clear();
+			labels.clear();
+			images.open(images_path, std::ios::binary);
+			labels.open(labels_path, std::ios::binary);
+			pos   = 0;
+			error = 0;
+
+			if (!images || !labels || read_header(images) != 0x803 || read_header(labels) != 0x801)
+				return 0;
+
+			std::size_t total = read_header(images);
+			image_size = read_header(images);
+			image_size *= read_header(images);
+
+			if (read_header(labels) != total || !images || !labels)
+				return 0;
+
+			if (size == -1)
+				size = total - offset;
+			if (offset < 0 || size < 0 || offset + size > total)
+				return 0;
+
+			from  = offset;
+			count = size;
+
+			images.seekg(16 + from * image_size);
+			labels.seekg(8 + from);
+			return (bool) images && (bool) labels;
+		};
+
+		int input_size() const { return image_size; };
+
+		int output_size() const { return 10; };
+
+		std::size_t size() const { return count; };
+
+		int read(double* inputs, double* outputs, int n) {
+			if (pos + n > count)
+				n = count - pos;
+			if (n <= 0 || error)
+				return 0;
+
+			pixels.resize((std::size_t) n * image_size);
+			digits.resize(n);
+
+			images.read(reinterpret_cast<char*>(pixels.data()), pixels.size());
+			labels.read(reinterpret_cast<char*>(digits.data()), digits.size());
+
+			// Keep samples with both image and label read
+			if (!images || !labels) {
+				error = 1;
+				n = std::min<std::size_t>(images.gcount() / image_size, labels.gcount());
+			}
+
+			for (std::size_t k = 0; k < (std::size_t) n * image_size; ++k)
+				inputs[k] = (double) pixels[k] * (1.0 / 255.0);
+
+			std::fill(outputs, outputs + (std::size_t) n * 10, 0.0);
+			for (int b = 0; b < n; ++b)
+				if (digits[b] < 10)
+					outputs[b * 10 + digits[b]] = 1.0;
+
+			pos += n;
+			return n;
+		};
+	};
+
+	// Reads chunks of samples from source in background thread ahead of consumer.
+	// Source must not be used by others while stream exists.
+	class DataStream {
+
+	public:
+
+		// Block of samples
+		struct Chunk {
+			// count rows of input size
+			std::vector<double> inputs;
+			// count rows of output size
+			std::vector<double> outputs;
+			// Amount of samples
+			int count = 0;
+		};
+
+	private:
+
+		SampleSource& source;
+		std::vector<Chunk> chunks;
+		// Ids of chunks available for reading and filled chunks in order
+		std::deque<int> free;
+		std::deque<int> ready;
+		// Chunk held by consumer, -1 if none
+		int current = -1;
+		// Source is read to the end
+		bool done = 0;
+		bool stop = 0;
+		// Source failed before the end
+		bool error = 0;
+
+		std::mutex lock;
+		std::condition_variable cv;
+		std::thread reader;
+
+		void run() {
+			while (1) {
+				int id;
+
+				{
+					std::unique_lock<std::mutex> guard(lock);
+					cv.wait(guard, [this] { return stop || free.size(); });
+					if (stop)
+						return;
+
+					id = free.front();
+					free.pop_front();
+				}
+
+				Chunk& c = chunks[id];
+				c.count = source.read(c.inputs.data(), c.outputs.data(), chunk_size);
+				bool last = c.count == 0 || source.failed();
+
+				{
+					std::lock_guard<std::mutex> guard(lock);
+					if (c.count)
+						ready.push_back(id);
+					if (last) {
+						done  = 1;
+						error = source.failed();
+					}
+				}
+
+				cv.notify_all();
+
+				if (last)
+					return;
+			}
+		};
+
+	public:
+
+		// Maximal amount of samples in chunk
+		const int chunk_size;
+
+		// source     - samples source
+		// chunk_size - amount of samples in chunk
+		// depth      - amount of chunks read ahead
+		DataStream(SampleSource& source, int chunk_size, int depth = 2) : source(source), chunk_size(std::max(1, chunk_size)) {
+			chunks.resize(std::max(1, depth) + 1);
+
+			for (int i = 0; i < chunks.size(); ++i) {
+				chunks[i].inputs.resize((std::size_t) this->chunk_size * source.input_size());
+				chunks[i].outputs.resize((std::size_t) this->chunk_size * source.output_size());
+				free.push_back(i);
+			}
+
+			reader = std::thread(&DataStream::run, this);
+		};
+
+		DataStream(const DataStream&) = delete;
+
+		DataStream& operator=(const DataStream&) = delete;
+
+		~DataStream() {
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				stop = 1;
+			}
+
+			cv.notify_all();
+			reader.join();
+		};
+
+		// Get next chunk, previous chunk is released.
+		// Returns nullptr at the end of source.
+		const Chunk* next() {
+			std::unique_lock<std::mutex> guard(lock);
+
+			if (current != -1) {
+				free.push_back(current);
+				current = -1;
+				cv.notify_all();
+			}
+
+			cv.wait(guard, [this] { return done || ready.size(); });
+			if (ready.empty())
+				return nullptr;
+
+			current = ready.front();
+			ready.pop_front();
+			return &chunks[current];
+		};
+
+		// Returns 1 if source failed, valid after next() returned nullptr
+		bool failed() {
+			std::lock_guard<std::mutex> guard(lock);
+			return error;
+		};
+	};
+};
@@ -0,0 +1,93 @@
+/*
+ * (c) Copyright bitrate16 (GPLv3.0) 2020
+ */
+
+#pragma once
+
+#include <string>
+#include <cstddef>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace NNSpace {
+
+	// Read-only memory mapping of the whole file
+	class MappedFile {
+
+		const char* ptr = nullptr;
+		std::size_t length = 0;
+
+	public:
+
+		MappedFile() {};
+
+		MappedFile(const std::string& path) {
+			open(path);
+		};
+
+		MappedFile(const MappedFile&) = delete;
+
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		MappedFile(MappedFile&& f) noexcept {
+			std::swap(ptr, f.ptr);
+			std::swap(length, f.length);
+		};
+
+		MappedFile& operator=(MappedFile&& f) noexcept {
+			std::swap(ptr, f.ptr);
+			std::swap(length, f.length);
+			return *this;
+		};
+
+		~MappedFile() {
+			close();
+		};
+
+		// Map file, returns 0 on failture or if file is empty
+		bool open(const std::string& path) {
+			close();
+
+			int fd = ::open(path.c_str(), O_RDONLY);
+			if (fd < 0)
+				return 0;
+
+			struct stat st;
+			if (fstat(fd, &st) != 0 || st.st_size == 0) {
+				::close(fd);
+				return 0;
+			}
+
+			void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+			::close(fd);
+			if (p == MAP_FAILED)
+				return 0;
+
+			ptr    = static_cast<const char*>(p);
+			length = st.st_size;
+			return 1;
+		};
+
+		void close() {
+			if (ptr)
+				munmap((void*) ptr, length);
+			ptr    = nullptr;
+			length = 0;
+		};
+
+		// Hint that file will be read sequentially
+		void sequential() const {
+			if (ptr)
+				madvise((void*) ptr, length, MADV_SEQUENTIAL);
+		};
+
+		inline bool is_open() const { return ptr; };
+
+		inline const char* data() const { return ptr; };
+
+		inline std::size_t size() const { return length; };
+	};
+};
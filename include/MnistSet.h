@@ -0,0 +1,162 @@
+/*
+ * (c) Copyright bitrate16 (GPLv3.0) 2020
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "MappedFile.h"
+
+namespace NNSpace {
+
+	// MNIST set mapped into memory.
+	// Images and labels are accessed in place, images of each part are contiguous.
+	// Normalized double inputs of the used range may be cached once with normalize_*().
+	class MnistSet {
+
+	public:
+
+		// Contiguous images, images[i][k] - pixel k of image i
+		struct Images {
+			const uint8_t* data = nullptr;
+			std::size_t count = 0;
+			int image_size = 0;
+
+			inline std::size_t size() const { return count; };
+
+			inline const uint8_t* operator[](std::size_t i) const { return data + i * image_size; };
+		};
+
+		// Contiguous labels
+		struct Labels {
+			const uint8_t* data = nullptr;
+			std::size_t count = 0;
+
+			inline std::size_t size() const { return count; };
+
+			inline uint8_t operator[](std::size_t i) const { return data[i]; };
+		};
+
+	private:
+
+		// Normalized inputs of images [offset, offset + size)
+		struct Cache {
+			std::vector<double> data;
+			int offset = 0;
+			int size = 0;
+		};
+
+		MappedFile files[4];
+		Cache training_cache;
+		Cache test_cache;
+
+		inline static uint32_t read_header(const char* data, int i) {
+			uint32_t v;
+			std::memcpy(&v, data + i * 4, 4);
+			return (v << 24) | ((v << 8) & 0x00FF0000) | ((v >> 8) & 0x0000FF00) | (v >> 24);
+		};
+
+		// Map images file (magic 0x803)
+		bool map_images(MappedFile& file, const std::string& path, Images& images) {
+			if (!file.open(path) || file.size() < 16 || read_header(file.data(), 0) != 0x803)
+				return 0;
+
+			images.count      = read_header(file.data(), 1);
+			images.image_size = read_header(file.data(), 2) * read_header(file.data(), 3);
+			images.data       = reinterpret_cast<const uint8_t*>(file.data() + 16);
+
+			return file.size() >= 16 + images.count * images.image_size;
+		};
+
+		// Map labels file (magic 0x801)
+		bool map_labels(MappedFile& file, const std::string& path, Labels& labels) {
+			if (!file.open(path) || file.size() < 8 || read_header(file.data(), 0) != 0x801)
+				return 0;
+
+			labels.count = read_header(file.data(), 1);
+			labels.data  = reinterpret_cast<const uint8_t*>(file.data() + 8);
+
+			return file.size() >= 8 + labels.count;
+		};
+
+		void normalize(const Images& images, Cache& cache, int offset, int size) {
+			cache.offset = offset;
+			cache.size   = size;
+			cache.data.resize((std::size_t) size * images.image_size);
+
+			const uint8_t* src = images[offset];
+			for (std::size_t k = 0; k < cache.data.size(); ++k)
+				cache.data[k] = (double) src[k] * (1.0 / 255.0);
+		};
+
+		// Normalized images [i, i + count), from cache if it covers the range or converted into buffer
+		const double* inputs(const Images& images, const Cache& cache, int i, int count, double* buffer) const {
+			if (i >= cache.offset && i + count <= cache.offset + cache.size)
+				return cache.data.data() + (std::size_t) (i - cache.offset) * images.image_size;
+
+			const uint8_t* src = images[i];
+			for (std::size_t k = 0; k < (std::size_t) count * images.image_size; ++k)
+				buffer[k] = (double) src[k] * (1.0 / 255.0);
+
+			return buffer;
+		};
+
+	public:
+
+		Images training_images;
+		Labels training_labels;
+		Images test_images;
+		Labels test_labels;
+
+		MnistSet() {};
+
+		MnistSet(const std::string& dir) {
+			open(dir);
+		};
+
+		// Map set files from directory, file names match mnist::read_dataset.
+		// Returns 0 on failture
+		bool open(const std::string& dir) {
+			bool ok = map_images(files[0], dir + "/train-images.idx3-ubyte", training_images)
+				&& map_labels(files[1], dir + "/train-labels.idx1-ubyte", training_labels)
+				&& map_images(files[2], dir + "/t10k-images.idx3-ubyte", test_images)
+				&& map_labels(files[3], dir + "/t10k-labels.idx1-ubyte", test_labels);
+
+			if (!ok || training_images.count != training_labels.count || test_images.count != test_labels.count) {
+				*this = MnistSet();
+				return 0;
+			}
+
+			return 1;
+		};
+
+		// Size of single image
+		inline int image_size() const { return training_images.image_size; };
+
+		// Cache normalized inputs of training images [offset, offset + size)
+		void normalize_training(int offset, int size) {
+			normalize(training_images, training_cache, offset, size);
+		};
+
+		// Cache normalized inputs of test images [offset, offset + size)
+		void normalize_test(int offset, int size) {
+			normalize(test_images, test_cache, offset, size);
+		};
+
+		// Normalized inputs of training images [i, i + count).
+		// Points into cache if range is cached, otherwise images are converted into buffer of count * image_size().
+		inline const double* training_inputs(int i, int count, double* buffer) const {
+			return inputs(training_images, training_cache, i, count, buffer);
+		};
+
+		// Normalized inputs of test images [i, i + count).
+		// Points into cache if range is cached, otherwise images are converted into buffer of count * image_size().
+		inline const double* test_inputs(int i, int count, double* buffer) const {
+			return inputs(test_images, test_cache, i, count, buffer);
+		};
+	};
+};
@@ -5,8 +5,13 @@
 #pragma once
 
 #include "Network.h"
+#include "WeightMatrix.h"
+#include "SparseMatrix.h"
+#include "TextFormat.h"
 
+#include <algorithm>
 #include <cstdlib>
+#include <cstdint>
 
 namespace NNSpace {
 	
@@ -18,34 +23,86 @@ namespace NNSpace {
 		
 	public:
 		
-		// Weights
-		std::vector<std::vector<std::vector<double>>> W;
+		// Weights, W[k] is contiguous matrix of layer k, W[k][i][j] / W[k].at(i, j)
+		std::vector<WeightMatrix> W;
 		// Offsets
 		std::vector<std::vector<double>> offsets;
 		// Activators
 		std::vector<NetworkFunction*> activators;
 		// Dimensions
 		std::vector<int> dimensions;
+		// Active neurons, mask[k][i] is 0 if neuron i of layer k is disabled.
+		// Empty for layers without disabled neurons.
+		std::vector<std::vector<uint8_t>> mask;
+		// Sparse form of layers, S[k] is not empty if layer k is evaluated as sparse matrix.
+		// Built from W by sparsify(), W stays the source of the weights.
+		std::vector<SparseMatrix> S;
+		
+		// Layers with lower fraction of non-zero weights are switched to sparse form by sparsify()
+		double sparse_density = SPARSE_DENSITY;
 		
 		bool enable_offsets = 0;
 		
+		// Order of weights in layer buffers
+		WeightLayout layout = ROW_MAJOR;
+		
 		MLNet() : Network() {};
 		
 		MLNet(const std::vector<int>& dim) : Network() {
 			set(dim);
 		};
 		
+		// Network owns activators, copy clones them
+		MLNet(const MLNet& net) : Network() {
+			net.copy_to(*this);
+		};
+		
+		MLNet(MLNet&& net) noexcept : Network() {
+			swap(net);
+		};
+		
+		MLNet& operator=(const MLNet& net) {
+			if (this != &net)
+				net.copy_to(*this);
+			return *this;
+		};
+		
+		MLNet& operator=(MLNet&& net) noexcept {
+			swap(net);
+			return *this;
+		};
+		
+		~MLNet() {
+			for (auto a : activators)
+				delete a;
+		};
+		
+		// Exchange state with other network without copying
+		void swap(MLNet& net) noexcept {
+			W.swap(net.W);
+			offsets.swap(net.offsets);
+			activators.swap(net.activators);
+			dimensions.swap(net.dimensions);
+			mask.swap(net.mask);
+			S.swap(net.S);
+			std::swap(sparse_density, net.sparse_density);
+			std::swap(enable_offsets, net.enable_offsets);
+			std::swap(layout, net.layout);
+		};
+		
 		void set(const std::vector<int>& dim) {
 			dimensions = dim;
 			
+			mask.clear();
+			mask.resize(dim.size());
+			
+			S.clear();
+			
 			W.clear();
 			
 			W.resize(dim.size() - 1);
-			for (int i = 0; i < dim.size() - 1; ++i) {
-				W[i].resize(dim[i]);
-				for (int j = 0; j < dim[i]; ++j)
-					W[i][j].resize(dim[i + 1]);
-			}
+			for (int i = 0; i < dim.size() - 1; ++i)
+				W[i].resize(dim[i], dim[i + 1], layout);
 			
 			offsets.clear();
 			
@@ -81,13 +138,15 @@ namespace NNSpace {
 		};
 		
 		void randomize(double dispersion) {
+			densify();
+			
 			double scale2 = dispersion * 0.5;
 			double v1_MAX = dispersion / RAND_MAX;
 			
 			for (int k = 0; k < dimensions.size() - 1; ++k)
 				for (int i = 0; i < dimensions[k]; ++i)
 					for (int j = 0; j < dimensions[k + 1]; ++j)
-						W[k][i][j] = rand() * v1_MAX - scale2;		
+						W[k].at(i, j) = rand() * v1_MAX - scale2;		
 
 			for (int i = 0; i < dimensions.size() - 1; ++i)
 				for (int j = 0; j < dimensions[i + 1]; ++j)
@@ -98,30 +157,141 @@ namespace NNSpace {
 			enable_offsets = e;
 		};
 		
-		// Assume input size match input layer size
-		std::vector<double> run(const std::vector<double>& input) {
-			std::vector<std::vector<double>> layers; // [0-N]
-			layers.resize(dimensions.size());
-			layers[0] = input;
+		// Change order of weights in layer buffers, keeps weight values
+		void setLayout(WeightLayout l) {
+			layout = l;
+			for (int k = 0; k < W.size(); ++k)
+				W[k].set_layout(l);
+		};
+		
+		// Enable or disable neuron i of layer k, input layer neurons can not be disabled.
+		// Disabled neuron outputs 0 and is not trained, its weights are kept.
+		void setActive(int k, int i, bool active) {
+			if (k <= 0 || k >= dimensions.size() || i < 0 || i >= dimensions[k])
+				throw std::runtime_error("Invalid neuron");
 			
-			// Regular process
-			for (int k = 0; k < dimensions.size() - 1; ++k) {
-				layers[k + 1].resize(dimensions[k + 1]);
+			if (mask.size() != dimensions.size())
+				mask.resize(dimensions.size());
+			
+			if (mask[k].empty()) {
+				if (active)
+					return;
+				mask[k].assign(dimensions[k], 1);
+			}
+			
+			mask[k][i] = active;
+		};
+		
+		inline bool isActive(int k, int i) const {
+			return k >= mask.size() || mask[k].empty() || mask[k][i];
+		};
+		
+		// Amount of active neurons of layer k
+		int activeCount(int k) const {
+			if (k >= mask.size() || mask[k].empty())
+				return dimensions[k];
+			return std::count(mask[k].begin(), mask[k].end(), 1);
+		};
+		
+		// Check if any neuron is disabled
+		bool masked() const {
+			for (int k = 0; k < mask.size(); ++k)
+				if (activeCount(k) != dimensions[k])
+					return 1;
+			return 0;
+		};
+		
+		// Zero values of disabled neurons of layer k in batch rows of layer size
+		inline void mask_layer(int k, double* values, std::size_t batch) const {
+			if (k >= mask.size() || mask[k].empty())
+				return;
+			
+			for (std::size_t b = 0; b < batch; ++b)
+				for (int i = 0; i < dimensions[k]; ++i)
+					if (!mask[k][i])
+						values[b * dimensions[k] + i] = 0.0;
+		};
+		
+		// Physically remove disabled neurons with their weights and offsets.
+		// Every layer must keep at least one active neuron.
+		void compact() {
+			for (int k = 1; k < mask.size(); ++k) {
+				if (mask[k].empty())
+					continue;
 				
-				// calculate RAW layer outputs & normalize them
-				for (int j = 0; j < dimensions[k + 1]; ++j) {
-					layers[k + 1][j] = enable_offsets ? offsets[k][j] : 0;
-					
-					for (int i = 0; i < dimensions[k]; ++i)
-						layers[k + 1][j] += layers[k][i] * W[k][i][j];
-					
-					// Normalize
-					layers[k + 1][j] = activators[k]->process(layers[k + 1][j]);
+				std::vector<int> keep;
+				for (int i = 0; i < dimensions[k]; ++i)
+					if (mask[k][i])
+						keep.push_back(i);
+				
+				int size = keep.size();
+				
+				// Incoming weights
+				WeightMatrix in(dimensions[k - 1], size, layout);
+				for (int i = 0; i < dimensions[k - 1]; ++i)
+					for (int j = 0; j < size; ++j)
+						in.at(i, j) = W[k - 1].at(i, keep[j]);
+				W[k - 1] = std::move(in);
+				
+				// Outcoming weights
+				if (k < dimensions.size() - 1) {
+					WeightMatrix out(size, dimensions[k + 1], layout);
+					for (int i = 0; i < size; ++i)
+						for (int j = 0; j < dimensions[k + 1]; ++j)
+							out.at(i, j) = W[k].at(keep[i], j);
+					W[k] = std::move(out);
 				}
+				
+				std::vector<double> off(size);
+				for (int j = 0; j < size; ++j)
+					off[j] = offsets[k - 1][keep[j]];
+				offsets[k - 1].swap(off);
+				
+				dimensions[k] = size;
+				mask[k].clear();
 			}
 			
+			sparsify();
+		};
+		
+		// Switch layers with fraction of non-zero weights below sparse_density to sparse form, other layers to dense.
+		// Called after network is loaded or compacted. Sparse form is copy of W,
+		//  after weights are changed directly network must be switched again by densify() or sparsify().
+		void sparsify() {
+			S.resize(W.size());
 			
-			return layers.back();
+			for (int k = 0; k < W.size(); ++k)
+				if (W[k].size() && W[k].nonzeros() < sparse_density * W[k].size())
+					S[k].assign(W[k]);
+				else
+					S[k].clear();
+		};
+		
+		// Switch all layers to dense form, called before weights are changed.
+		// Only reads network if it is already dense.
+		inline void densify() {
+			if (S.size())
+				S.clear();
+		};
+		
+		inline bool isSparse(int k) const {
+			return k < S.size() && !S[k].empty();
+		};
+		
+		// Weight of connection from neuron i of layer k to neuron j of layer k + 1
+		inline double& weight(int k, int i, int j) {
+			return W[k].at(i, j);
+		};
+		
+		inline const double& weight(int k, int i, int j) const {
+			return W[k].at(i, j);
+		};
+		
+		// Assume input size match input layer size
+		std::vector<double> run(const std::vector<double>& input) {
+			std::vector<double> output;
+			run(input, output);
+			return output;
 		};
 		
 		void run(const std::vector<double>& input, std::vector<double>& output) {
@@ -133,43 +303,68 @@ namespace NNSpace {
 			// Regular process
 			for (int k = 0; k < dimensions.size() - 1; ++k) {
 				if (k)
-					layer.assign(output.begin(), output.end());
-				
-				output.resize(dimensions[k + 1]);
+					layer.swap(output);
 				
 				// calculate RAW layer outputs & normalize them
-				for (int j = 0; j < dimensions[k + 1]; ++j) {
-					output[j] = enable_offsets ? offsets[k][j] : 0;
-					
-					for (int i = 0; i < dimensions[k]; ++i)
-						output[j] += layer[i] * W[k][i][j];
-					
-					// Normalize
-					output[j] = activators[k]->process(output[j]);
-				}
+				if (enable_offsets)
+					output.assign(offsets[k].begin(), offsets[k].end());
+				else
+					output.assign(dimensions[k + 1], 0.0);
+				
+				if (isSparse(k))
+					S[k].multiply(layer.data(), output.data());
+				else
+					W[k].multiply(layer.data(), output.data());
+				
+				// Normalize
+				activate_layer(activators[k]->getType(), output.data(), output.data(), dimensions[k + 1]);
+				mask_layer(k + 1, output.data(), 1);
 			}
+		};
+		
+		// Run batch of inputs at once, layer by layer as matrix-matrix products.
+		// inputs  - batch rows of input layer size
+		// outputs - batch rows of output layer size
+		void run_batch(const double* inputs, size_t batch, double* outputs) {
+			if (batch == 0)
+				return;
 			
-			std::vector<std::vector<double>> layers; // [0-N]
-			layers.resize(dimensions.size());
-			layers[0] = input;
+			int max_dim = *std::max_element(dimensions.begin() + 1, dimensions.end());
+			
+			// Previous & current layer values
+			std::vector<double> layer;
+			std::vector<double> next((size_t) max_dim * batch);
+			if (dimensions.size() > 2)
+				layer.resize((size_t) max_dim * batch);
+			
+			const double* in = inputs;
 			
-			// Regular process
 			for (int k = 0; k < dimensions.size() - 1; ++k) {
-				layers[k + 1].resize(dimensions[k + 1]);
+				double* out = (k == dimensions.size() - 2) ? outputs : next.data();
+				int size = dimensions[k + 1];
 				
 				// calculate RAW layer outputs & normalize them
-				for (int j = 0; j < dimensions[k + 1]; ++j) {
-					layers[k + 1][j] = enable_offsets ? offsets[k][j] : 0;
-					
-					for (int i = 0; i < dimensions[k]; ++i)
-						layers[k + 1][j] += layers[k][i] * W[k][i][j];
-					
-					// Normalize
-					layers[k + 1][j] = activators[k]->process(layers[k + 1][j]);
-				}
+				for (size_t b = 0; b < batch; ++b)
+					if (enable_offsets)
+						std::copy(offsets[k].begin(), offsets[k].end(), out + b * size);
+					else
+						std::fill(out + b * size, out + (b + 1) * size, 0.0);
+				
+				if (isSparse(k))
+					S[k].multiply_batch(in, batch, out);
+				else
+					W[k].multiply_batch(in, batch, out);
+				
+				// Normalize
+				activate_layer(activators[k]->getType(), out, out, batch * size);
+				mask_layer(k + 1, out, batch);
+				
+				layer.swap(next);
+				in = layer.data();
 			}
 		};
 		
+		// Numbers are written in shortest form that is read back to the same value
 		void serialize(std::ostream& os) {
 			// Format:
 			// 1. number of layers
@@ -180,78 +375,128 @@ namespace NNSpace {
 			// 2n+2. one by one weight matrices
 			// 2n+3. offset matrix
 			// 2n+4. enable offsets
-			os << dimensions.size();
-			os << std::endl;
-			os << std::endl;
+			// 2n+5. if any neuron is disabled, "mask" and for each layer
+			//       amount of disabled neurons followed by their indices
+			text::Writer out(os);
+			
+			out.put((int) dimensions.size()).put('\n').put('\n');
 			
 			for (int k = 0; k < dimensions.size(); ++k)
-				os << dimensions[k] << ' ';
-			os << std::endl;
-			os << std::endl;
+				out.put(dimensions[k]).put(' ');
+			out.put('\n').put('\n');
 			
 			for (int i = 0; i < activators.size(); ++i)
-				os << (int) activators[i]->getType() << ' ';
-			os << std::endl;
-			os << std::endl;
+				out.put((int) activators[i]->getType()).put(' ');
+			out.put('\n').put('\n');
 			
 			for (int k = 0; k < dimensions.size() - 1; ++k) {
-				for (int i = 0; i < dimensions[k]; ++i)
-					for (int j = 0; j < dimensions[k + 1]; ++j) 
-						os << W[k][i][j] << ' ';
-				os << std::endl;
+				if (layout == ROW_MAJOR)
+					for (std::size_t i = 0; i < W[k].size(); ++i)
+						out.put(W[k].data[i]).put(' ');
+				else
+					for (int i = 0; i < dimensions[k]; ++i)
+						for (int j = 0; j < dimensions[k + 1]; ++j) 
+							out.put(W[k].at(i, j)).put(' ');
+				out.put('\n');
 			}
-			os << std::endl;
+			out.put('\n');
 			
 			for (int i = 0; i < dimensions.size() - 1; ++i) {
 				for (int j = 0; j < dimensions[i + 1]; ++j)
-					os << offsets[i][j] << ' ';
-				os << std::endl;
+					out.put(offsets[i][j]).put(' ');
+				out.put('\n');
 			}
-			os << std::endl;
+			out.put('\n');
 			
-			os << enable_offsets;
+			out.put((int) enable_offsets);
+			
+			if (masked()) {
+				out.put('\n').put('\n').put("mask").put('\n');
+				
+				for (int k = 0; k < dimensions.size(); ++k) {
+					out.put(dimensions[k] - activeCount(k));
+					for (int i = 0; i < dimensions[k]; ++i)
+						if (!isActive(k, i))
+							out.put(' ').put(i);
+					out.put('\n');
+				}
+			}
 		};
 		
 		bool deserialize(std::istream& is) {
+			text::Reader in(is);
+			
 			int size;
-			is >> size;
+			if (!in.get(size) || size < 2)
+				return 0;
+			
 			dimensions.resize(size);
 			
 			for (int k = 0; k < dimensions.size(); ++k)
-				is >> dimensions[k];
+				if (!in.get(dimensions[k]) || dimensions[k] <= 0)
+					return 0;
 			
 			set(dimensions);
 			
 			for (int i = 0; i < size - 1; ++i) {
 				int ac;
-				is >> ac;
+				in.get(ac);
 				
+				delete activators[i];
 				activators[i] = getActivatorByType((ActivatorType) ac);
 			}
 			
 			for (int k = 0; k < dimensions.size() - 1; ++k)
-				for (int i = 0; i < dimensions[k]; ++i)
-					for (int j = 0; j < dimensions[k + 1]; ++j) 
-						is >> W[k][i][j];
+				if (layout == ROW_MAJOR)
+					for (std::size_t i = 0; i < W[k].size(); ++i)
+						in.get(W[k].data[i]);
+				else
+					for (int i = 0; i < dimensions[k]; ++i)
+						for (int j = 0; j < dimensions[k + 1]; ++j) 
+							in.get(W[k].at(i, j));
 			
 			for (int i = 0; i < dimensions.size() - 1; ++i)
 				for (int j = 0; j < dimensions[i + 1]; ++j)
-					is >> offsets[i][j];
+					in.get(offsets[i][j]);
 				
-			is >> enable_offsets;
+			in.get(enable_offsets);
 			
-			if (is.fail())
+			if (in.fail)
 				return 0;
 			
+			// Optional mask
+			if (in.skip("mask"))
+				for (int k = 0; k < dimensions.size(); ++k) {
+					int count = 0;
+					if (!in.get(count) || count < 0 || count > dimensions[k] || (k == 0 && count))
+						return 0;
+					
+					for (int n = 0; n < count; ++n) {
+						int i = -1;
+						if (!in.get(i) || i < 0 || i >= dimensions[k])
+							return 0;
+						
+						setActive(k, i, 0);
+					}
+				}
+			
+			sparsify();
+			
 			return 1;
 		};
 	
 		// Makes a full copy of the network
-		inline void copy_to(MLNet& dest) {
+		inline void copy_to(MLNet& dest) const {
 			dest.enable_offsets = enable_offsets;
+			dest.layout         = layout;
 			dest.dimensions     = dimensions;
+			dest.mask           = mask;
 			dest.offsets        = offsets;
 			dest.W              = W;
+			dest.S              = S;
+			dest.sparse_density = sparse_density;
+			for (auto a : dest.activators)
+				delete a;
 			dest.activators.resize(activators.size());
 			for (int i = 0; i < activators.size(); ++i)
 				dest.activators[i] = activators[i]->clone();
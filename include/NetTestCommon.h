@@ -17,6 +17,10 @@
 #include "mnist/mnist_reader.hpp"
 #include "SingleLayerNetwork.h"
 #include "MultiLayerNetwork.h"
+#include "NetworkFile.h"
+#include "MnistSet.h"
+#include "SetFile.h"
+#include "TextFormat.h"
 
 // > Appriximation testing
 // 1. Generate test for function
@@ -83,6 +87,37 @@ namespace NNSpace {
 		};
 		
 		
+		// Generate Set for function approximation, function is evaluated over all points at once
+		// function - columnar value generator, function(t, n, y) writes values of n points t into y
+		// a        - begin point
+		// b        - end point
+		// amount   - amount of points in a set
+		// random   - points are selected randomly, else sector is split into $amount points
+		void gen_approx_fun(std::vector<std::pair<double, double>>& points, std::function<void(const double*, std::size_t, double*)> function, double a, double b, int amount, bool random) {
+			std::vector<double> t(amount);
+			std::vector<double> y(amount);
+			
+			if (random) {
+				std::random_device rd;
+				std::mt19937 e2(rd());
+				std::uniform_real_distribution<> dist(a, b);
+				
+				for (int i = 0; i < amount; ++i)
+					t[i] = dist(e2);
+			} else {
+				double step = (b - a) / static_cast<double>(amount + 1);
+				for (int i = 0; i < amount; ++i)
+					t[i] = ((double) i) * step;
+			}
+			
+			function(t.data(), amount, y.data());
+			
+			points.resize(amount);
+			for (int i = 0; i < amount; ++i)
+				points[i] = std::pair<double, double>(t[i], y[i]);
+		};
+		
+		
 		// Generate Set for ND function approximation, random
 		// X value distributed between A and B (Ai <= Xi <= Bi)
 		// Assume $function takes as much arguments as size of A and B
@@ -117,9 +152,29 @@ namespace NNSpace {
 		};
 		
 		// Write given set to the file
-		// set  - input set
-		// name - output file name
-		bool write_approx_set(std::vector<std::pair<std::vector<double>, double>>& set, const std::string& filename) {
+		// set    - input set
+		// name   - output file name
+		// binary - use binary columnar format (see SetFile.h)
+		bool write_approx_set(std::vector<std::pair<std::vector<double>, double>>& set, const std::string& filename, bool binary = 0) {
+			int x_size = set.size() ? set[0].first.size() : 0;
+			
+			if (binary) {
+				std::vector<std::vector<double>> x(x_size, std::vector<double>(set.size()));
+				std::vector<double> y(set.size());
+				std::vector<const double*> columns(x_size);
+				
+				for (int i = 0; i < set.size(); ++i) {
+					for (int k = 0; k < x_size; ++k)
+						x[k][i] = set[i].first[k];
+					y[i] = set[i].second;
+				}
+				
+				for (int k = 0; k < x_size; ++k)
+					columns[k] = x[k].data();
+				
+				return NNSpace::setfile::write(filename, set.size(), x_size, columns, y.data());
+			}
+			
 			std::ofstream of;
 			of.open(filename);
 			if (of.fail()) 
@@ -129,16 +184,16 @@ namespace NNSpace {
 			// Count X_size 
 			// Data:{X, Y}
 			
-			if (set.size() == 0)
-				of << "0 0";
-			else {
-				of << set.size() << ' ' << set[0].first.size() << std::endl;
+			{
+				NNSpace::text::Writer out(of);
+				
+				out.put((int) set.size()).put(' ').put(x_size).put('\n');
 				
 				for (int i = 0; i < set.size(); ++i) {
 					for (int k = 0; k < set[i].first.size(); ++k)
-						of << set[i].first[k] << ' ';
+						out.put(set[i].first[k]).put(' ');
 					
-					of << set[i].second << std::endl;
+					out.put(set[i].second).put('\n');
 				}
 			}
 			of.flush();
@@ -147,10 +202,28 @@ namespace NNSpace {
 			return 1;
 		};
 		
-		// Read given set from file
+		// Read given set from file, format is detected by file header
 		// set  - output set
 		// name - input file
 		bool read_approx_set(std::vector<std::pair<std::vector<double>, double>>& set, const std::string& filename) {
+			if (NNSpace::setfile::is_binary(filename)) {
+				NNSpace::setfile::MappedSet map;
+				if (!map.open(filename))
+					return 0;
+				
+				set.resize(map.count);
+				for (std::size_t i = 0; i < map.count; ++i) {
+					set[i].first.resize(map.x_size);
+					
+					for (int k = 0; k < map.x_size; ++k)
+						set[i].first[k] = map.x(k)[i];
+					
+					set[i].second = map.y()[i];
+				}
+				
+				return 1;
+			}
+			
 			std::ifstream is;
 			is.open(filename);
 			if (is.fail()) 
@@ -160,32 +233,46 @@ namespace NNSpace {
 			// Count X_size 
 			// Data:{X, Y}
 			
+			NNSpace::text::Reader in(is);
+			
 			int count  = 0;
 			int x_size = 0;
 			
-			is >> count >> x_size;
-			if (is.fail()) {
-				is.close();
+			in.get(count);
+			in.get(x_size);
+			if (in.fail || count < 0 || x_size < 0)
 				return 0;
-			}
 			
 			set.resize(count);
 			for (int i = 0; i < count; ++i) {
 				set[i].first.resize(x_size);
 				
 				for (int k = 0; k < x_size; ++k)
-					is >> set[i].first[k];
+					in.get(set[i].first[k]);
 				
-				is >> set[i].second;
+				in.get(set[i].second);
 			}
 			
 			return 1;
 		};
 		
 		// Write given set to the file
-		// set  - input set
-		// name - output file name
-		bool write_approx_set(std::vector<std::pair<double, double>>& set, const std::string& filename) {
+		// set    - input set
+		// name   - output file name
+		// binary - use binary columnar format (see SetFile.h)
+		bool write_approx_set(std::vector<std::pair<double, double>>& set, const std::string& filename, bool binary = 0) {
+			if (binary) {
+				std::vector<double> x(set.size());
+				std::vector<double> y(set.size());
+				
+				for (int i = 0; i < set.size(); ++i) {
+					x[i] = set[i].first;
+					y[i] = set[i].second;
+				}
+				
+				return NNSpace::setfile::write(filename, set.size(), 1, { x.data() }, y.data());
+			}
+			
 			std::ofstream of;
 			of.open(filename);
 			if (of.fail()) 
@@ -195,13 +282,13 @@ namespace NNSpace {
 			// Count X_size 
 			// Data:{X, Y}
 			
-			if (set.size() == 0)
-				of << "0 1";
-			else {
-				of << set.size() << ' ' << 1 << std::endl;
+			{
+				NNSpace::text::Writer out(of);
+				
+				out.put((int) set.size()).put(' ').put(1).put('\n');
 				
 				for (int i = 0; i < set.size(); ++i)
-					of << set[i].first << ' ' << set[i].second << std::endl;
+					out.put(set[i].first).put(' ').put(set[i].second).put('\n');
 			}
 			of.flush();
 			of.close();
@@ -209,10 +296,22 @@ namespace NNSpace {
 			return 1;
 		};
 		
-		// Read given set from file
+		// Read given set from file, format is detected by file header
 		// set  - output set
 		// name - input file
 		bool read_approx_set(std::vector<std::pair<double, double>>& set, const std::string& filename) {
+			if (NNSpace::setfile::is_binary(filename)) {
+				NNSpace::setfile::MappedSet map;
+				if (!map.open(filename) || (map.count && map.x_size != 1))
+					return 0;
+				
+				set.resize(map.count);
+				for (std::size_t i = 0; i < map.count; ++i)
+					set[i] = std::pair<double, double>(map.x(0)[i], map.y()[i]);
+				
+				return 1;
+			}
+			
 			std::ifstream is;
 			is.open(filename);
 			if (is.fail()) 
@@ -222,22 +321,25 @@ namespace NNSpace {
 			// Count X_size 
 			// Data:{X, Y}
 			
+			NNSpace::text::Reader in(is);
+			
 			int count  = 0;
 			int x_size = 0;
 			
-			is >> count >> x_size;
+			in.get(count);
+			in.get(x_size);
 			
 			if (count && x_size != 1)
 				return 0;
 			
-			if (is.fail()) {
-				is.close();
+			if (in.fail || count < 0)
 				return 0;
-			}
 			
 			set.resize(count);
-			for (int i = 0; i < count; ++i) 
-				is >> set[i].first >> set[i].second;
+			for (int i = 0; i < count; ++i) {
+				in.get(set[i].first);
+				in.get(set[i].second);
+			}
 			
 			return 1;
 		};
@@ -347,6 +449,45 @@ namespace NNSpace {
 			return std::experimental::filesystem::remove_all(directory);
 		};
 
+		// Write single network
+		// binary - use binary format (see NetworkFile.h)
+		bool write_network(NNSpace::MLNet& net, const std::string& out_file, bool binary = 0) {
+			if (binary)
+				return NNSpace::netfile::write(net, out_file);
+			
+			std::ofstream of;
+			of.open(out_file);
+			
+			if (of.fail()) 
+				return 0;
+			
+			net.serialize(of);
+			
+			of.flush();
+			of.close();
+			
+			return 1;
+		};
+		
+		// Read single network, format is detected by file header
+		bool read_network(NNSpace::MLNet& net, const std::string& in_file) {
+			if (NNSpace::netfile::is_binary(in_file))
+				return NNSpace::netfile::read(net, in_file);
+			
+			std::ifstream is;
+			is.open(in_file);
+			
+			if (is.fail()) 
+				return 0;
+			
+			if (!net.deserialize(is))
+				return 0;
+			
+			is.close();
+			
+			return 1;
+		};
+
 		// Write networks
 		bool write_networks(std::vector<NNSpace::MLNet>& net, const std::string& out_dir) {
 			std::error_code ec;
@@ -374,18 +515,9 @@ namespace NNSpace {
 		bool read_networks(std::vector<NNSpace::MLNet>& net, const std::string& in_dir, int count) {
 			net.resize(count);
 			
-			for (int i = 0; i < count; ++i) {
-				std::ifstream is;
-				std::string filename = in_dir + "/network_" + std::to_string(i) + ".neetwook";
-				
-				is.open(filename);
-				if (is.fail()) 
+			for (int i = 0; i < count; ++i)
+				if (!read_network(net[i], in_dir + "/network_" + std::to_string(i) + ".neetwook"))
 					return 0;
-				
-				net[i].deserialize(is);
-				
-				is.close();
-			}
 			
 			return 1;
 		};
@@ -413,54 +545,44 @@ namespace NNSpace {
 		
 		// Read single ordered network
 		bool read_network(NNSpace::MLNet& net, const std::string& in_dir, int i) {
-			std::ifstream is;
-			std::string filename = in_dir + "/network_" + std::to_string(i) + ".neetwook";
-			
-			is.open(filename);
-			if (is.fail()) 
-				return 0;
-			
-			net.deserialize(is);
-			
-			is.close();
-			
-			return 1;
+			return read_network(net, in_dir + "/network_" + std::to_string(i) + ".neetwook");
 		};
 	
-		// Write single network
-		bool write_network(NNSpace::MLNet& net, const std::string& out_file) {
-			std::ofstream of;
-			of.open(out_file);
-			
-			if (of.fail()) 
-				return 0;
-			
-			net.serialize(of);
-			
-			of.flush();
-			of.close();
-			
-			return 1;
+		
+		// T E S T I N G
+		
+		
+		// Amount of samples passed to the network at once by the testing functions
+		const int TEST_BATCH = 256;
+		
+		// Add error of points [from, from + count) to error
+		// outputs - count rows of out_size network output values
+		void add_approx_error(long double& error, const double* outputs, int out_size, std::vector<std::pair<double, double>>& set, int from, int count, int Ltype) {
+			for (int b = 0; b < count; ++b) {
+				long double dv = set[from + b].second - outputs[b * out_size];
+				
+				if (Ltype == 1)
+					error += std::fabs(dv);
+				if (Ltype == 2)
+					error += dv * dv;
+			}
 		};
 		
-		// Read single network
-		bool read_network(NNSpace::MLNet& net, const std::string& in_file) {
-			std::ifstream is;
-			is.open(in_file);
-			
-			if (is.fail()) 
+		// Calculate average error of already calculated network outputs
+		// outputs - set.size() rows of out_size values
+		double calculate_approx_error(const double* outputs, int out_size, std::vector<std::pair<double, double>>& set, int Ltype = 1) {
+			if (set.size() == 0)
 				return 0;
 			
-			net.deserialize(is);
-			
-			is.close();
+			long double error = 0;
+			add_approx_error(error, outputs, out_size, set, 0, set.size(), Ltype);
 			
-			return 1;
+			if (Ltype == 1)
+				return error / (double) set.size();
+			if (Ltype == 2)
+				return std::sqrt(error / (double) set.size());
+			return 0;
 		};
-	
-		
-		// T E S T I N G
-		
 		
 		// Calculate average error on the output layer
 		// Ltype defines the L1 or L2 usage.
@@ -468,21 +590,21 @@ namespace NNSpace {
 			if (set.size() == 0)
 				return 0;
 			
-			std::vector<double> input(1);
-			std::vector<double> output(1);
+			int out_size = net.dimensions.back();
+			std::vector<double> input(TEST_BATCH);
+			std::vector<double> output(TEST_BATCH * out_size);
 			
 			long double error = 0;
 			
-			for (int i = 0; i < set.size(); ++i) {
-				input[0] = set[i].first;
-				net.run(input, output);
+			for (int i = 0; i < set.size(); i += TEST_BATCH) {
+				int batch = std::min(TEST_BATCH, (int) set.size() - i);
 				
-				long double dv = set[i].second - output[0];
+				for (int b = 0; b < batch; ++b)
+					input[b] = set[i + b].first;
 				
-				if (Ltype == 1)
-					error += std::fabs(dv);
-				if (Ltype == 2)
-					error += dv * dv;
+				net.run_batch(input.data(), batch, output.data());
+				
+				add_approx_error(error, output.data(), out_size, set, i, batch, Ltype);
 			}
 			
 			if (Ltype == 1)
@@ -498,18 +620,28 @@ namespace NNSpace {
 			if (set.size() == 0)
 				return 0;
 			
-			std::vector<double> output(1);
+			int in_size  = net.dimensions.front();
+			int out_size = net.dimensions.back();
+			std::vector<double> input(TEST_BATCH * in_size);
+			std::vector<double> output(TEST_BATCH * out_size);
 			
 			long double error = 0;
 			
-			for (int i = 0; i < set.size(); ++i) {
-				net.run(set[i].first, output);
+			for (int i = 0; i < set.size(); i += TEST_BATCH) {
+				int batch = std::min(TEST_BATCH, (int) set.size() - i);
 				
-				long double dv = set[i].second - output[0];
-				if (Ltype == 1)
-					error += std::fabs(dv);
-				if (Ltype == 2)
-					error += dv * dv;
+				for (int b = 0; b < batch; ++b)
+					std::copy(set[i + b].first.begin(), set[i + b].first.end(), input.begin() + b * in_size);
+				
+				net.run_batch(input.data(), batch, output.data());
+				
+				for (int b = 0; b < batch; ++b) {
+					long double dv = set[i + b].second - output[b * out_size];
+					if (Ltype == 1)
+						error += std::fabs(dv);
+					if (Ltype == 2)
+						error += dv * dv;
+				}
 			}
 			
 			if (Ltype == 1)
@@ -523,20 +655,27 @@ namespace NNSpace {
 			if (set.size() == 0)
 				return 0;
 			
-			std::vector<double> input(1);
-			std::vector<double> output(1);
+			int out_size = net.dimensions.back();
+			std::vector<double> input(TEST_BATCH);
+			std::vector<double> output(TEST_BATCH * out_size);
 			
 			long double error_max = 0;
 			
-			for (int i = 0; i < set.size(); ++i) {
-				input[0] = set[i].first;
-				net.run(input, output);
+			for (int i = 0; i < set.size(); i += TEST_BATCH) {
+				int batch = std::min(TEST_BATCH, (int) set.size() - i);
 				
-				long double dv = std::fabs(set[i].second - output[0]);
-				if (Ltype == 2)
-					dv *= dv;
-				if (error_max < dv)
-					error_max = dv;
+				for (int b = 0; b < batch; ++b)
+					input[b] = set[i + b].first;
+				
+				net.run_batch(input.data(), batch, output.data());
+				
+				for (int b = 0; b < batch; ++b) {
+					long double dv = std::fabs(set[i + b].second - output[b * out_size]);
+					if (Ltype == 2)
+						dv *= dv;
+					if (error_max < dv)
+						error_max = dv;
+				}
 			}
 			
 			return error_max;
@@ -548,18 +687,28 @@ namespace NNSpace {
 			if (set.size() == 0)
 				return 0;
 			
-			std::vector<double> output(1);
+			int in_size  = net.dimensions.front();
+			int out_size = net.dimensions.back();
+			std::vector<double> input(TEST_BATCH * in_size);
+			std::vector<double> output(TEST_BATCH * out_size);
 			
 			long double error_max = 0;
 			
-			for (int i = 0; i < set.size(); ++i) {
-				net.run(set[i].first, output);
+			for (int i = 0; i < set.size(); i += TEST_BATCH) {
+				int batch = std::min(TEST_BATCH, (int) set.size() - i);
 				
-				long double dv = std::fabs(set[i].second - output[0]);
-				if (Ltype == 2)
-					dv *= dv;
-				if (error_max < dv)
-					error_max = dv;
+				for (int b = 0; b < batch; ++b)
+					std::copy(set[i + b].first.begin(), set[i + b].first.end(), input.begin() + b * in_size);
+				
+				net.run_batch(input.data(), batch, output.data());
+				
+				for (int b = 0; b < batch; ++b) {
+					long double dv = std::fabs(set[i + b].second - output[b * out_size]);
+					if (Ltype == 2)
+						dv *= dv;
+					if (error_max < dv)
+						error_max = dv;
+				}
 			}
 			
 			return error_max;
@@ -575,7 +724,12 @@ namespace NNSpace {
 			return set.training_images.size();
 		};
 		
-		long double calculate_mnist_error(NNSpace::MLNet& net, mnist::MNIST_dataset<std::vector, std::vector<uint8_t>, uint8_t>& set, int Ltype = 1, int offset = 0, int size = -1) {
+		// Map set files, images are not copied
+		bool load_mnist(NNSpace::MnistSet& set, const std::string& dir) {
+			return set.open(dir) && set.training_images.size();
+		};
+		
+		long double calculate_mnist_error(NNSpace::MLNet& net, NNSpace::MnistSet& set, int Ltype = 1, int offset = 0, int size = -1) {
 			if (size == -1)
 				size = set.test_images.size();
 			if (offset >= set.test_images.size())
@@ -591,29 +745,30 @@ namespace NNSpace {
 			
 			long double error = 0;
 			
-			std::vector<double> input(28 * 28);
-			std::vector<double> output(10);
+			std::vector<double> input(TEST_BATCH * set.image_size());
+			std::vector<double> output(TEST_BATCH * 10);
 			
-			for (int i = offset; i < offset + size; ++i) {
-				for (int k = 0; k < 28 * 28; ++k)
-					input[k] = (double) set.test_images[i][k]  * (1.0 / 255.0);
+			for (int i = offset; i < offset + size; i += TEST_BATCH) {
+				int batch = std::min(TEST_BATCH, offset + size - i);
 				
-				output = net.run(input);
+				net.run_batch(set.test_inputs(i, batch, input.data()), batch, output.data());
 				
-				long double local_error = 0;
-				for (int j = 0; j < 10; ++j) {
-					long double dv = (set.test_labels[i] == j) ? 1.0 - output[j] : output[j];
+				for (int b = 0; b < batch; ++b) {
+					long double local_error = 0;
+					for (int j = 0; j < 10; ++j) {
+						long double dv = (set.test_labels[i + b] == j) ? 1.0 - output[b * 10 + j] : output[b * 10 + j];
+						
+						if (Ltype == 1)
+							local_error += std::fabs(dv);
+						else if (Ltype == 2)
+							local_error += dv * dv;
+					}
 					
 					if (Ltype == 1)
-						local_error += std::fabs(dv);
+						error += local_error * 0.1;
 					else if (Ltype == 2)
-						local_error += dv * dv;
+						error += std::sqrt(local_error * 0.1);
 				}
-				
-				if (Ltype == 1)
-					error += local_error * 0.1;
-				else if (Ltype == 2)
-					error += std::sqrt(local_error * 0.1);
 			}
 			
 			if (Ltype == 1)
@@ -623,7 +778,29 @@ namespace NNSpace {
 			return 0;
 		};
 		
-		long double calculate_mnist_match(NNSpace::MLNet& net, mnist::MNIST_dataset<std::vector, std::vector<uint8_t>, uint8_t>& set, int offset = 0, int size = -1) {
+		// Amount of correctly recognized test images [offset, offset + size)
+		// outputs - size rows of 10 network output values
+		int count_mnist_match(const double* outputs, NNSpace::MnistSet& set, int offset, int size) {
+			int correct = 0;
+			
+			for (int b = 0; b < size; ++b) {
+				double max = 0;
+				double max_ind = 0;
+				
+				for (int j = 0; j < 10; ++j) 
+					if (outputs[b * 10 + j] > max) {
+						max = outputs[b * 10 + j];
+						max_ind = j;
+					}
+				
+				if (max_ind == set.test_labels[offset + b])
+					++correct;
+			}
+			
+			return correct;
+		};
+		
+		long double calculate_mnist_match(NNSpace::MLNet& net, NNSpace::MnistSet& set, int offset = 0, int size = -1) {
 			if (size == -1)
 				size = set.test_images.size();
 			if (offset >= set.test_images.size())
@@ -635,32 +812,30 @@ namespace NNSpace {
 			
 			int correct = 0;
 			
-			std::vector<double> input(28 * 28);
-			std::vector<double> output(10);
+			std::vector<double> input(TEST_BATCH * set.image_size());
+			std::vector<double> output(TEST_BATCH * 10);
 			
-			for (int i = offset; i < offset + size; ++i) {
-				for (int k = 0; k < 28 * 28; ++k)
-					input[k] = (double) set.test_images[i][k]  * (1.0 / 255.0);
-				
-				output = net.run(input);
+			for (int i = offset; i < offset + size; i += TEST_BATCH) {
+				int batch = std::min(TEST_BATCH, offset + size - i);
 				
-				double max = 0;
-				double max_ind = 0;
+				net.run_batch(set.test_inputs(i, batch, input.data()), batch, output.data());
 				
-				for (int j = 0; j < 10; ++j) 
-					if (output[j] > max) {
-						max = output[j];
-						max_ind = j;
-					}
-				
-				if (max_ind == set.test_labels[i])
-					++correct;
+				correct += count_mnist_match(output.data(), set, i, batch);
 			}
 			
 			return (double) correct / (double) size;
 		};
 		
-		long double calculate_mnist_error_max(NNSpace::MLNet& net, mnist::MNIST_dataset<std::vector, std::vector<uint8_t>, uint8_t>& set, int Ltype = 1, int offset = 0, int size = -1) {
+		// Calculate match of already calculated network outputs for test images [offset, offset + size)
+		// outputs - size rows of 10 values
+		long double calculate_mnist_match(const double* outputs, NNSpace::MnistSet& set, int offset, int size) {
+			if (size <= 0)
+				return 0;
+			
+			return (double) count_mnist_match(outputs, set, offset, size) / (double) size;
+		};
+		
+		long double calculate_mnist_error_max(NNSpace::MLNet& net, NNSpace::MnistSet& set, int Ltype = 1, int offset = 0, int size = -1) {
 			if (size == -1)
 				size = set.test_images.size();
 			if (offset >= set.test_images.size())
@@ -670,32 +845,33 @@ namespace NNSpace {
 			
 			long double max_error = 0;
 			
-			std::vector<double> input(28 * 28);
-			std::vector<double> output(10);
+			std::vector<double> input(TEST_BATCH * set.image_size());
+			std::vector<double> output(TEST_BATCH * 10);
 			
-			for (int i = offset; i < offset + size; ++i) {
-				for (int k = 0; k < 28 * 28; ++k)
-					input[k] = (double) set.test_images[i][k]  * (1.0 / 255.0);
+			for (int i = offset; i < offset + size; i += TEST_BATCH) {
+				int batch = std::min(TEST_BATCH, offset + size - i);
 				
-				output = net.run(input);
+				net.run_batch(set.test_inputs(i, batch, input.data()), batch, output.data());
 				
-				long double local_error = 0;
-				for (int j = 0; j < 10; ++j) {
-					long double dv = (set.test_labels[i] == j) ? 1.0 - output[j] : output[j];
+				for (int b = 0; b < batch; ++b) {
+					long double local_error = 0;
+					for (int j = 0; j < 10; ++j) {
+						long double dv = (set.test_labels[i + b] == j) ? 1.0 - output[b * 10 + j] : output[b * 10 + j];
+						
+						if (Ltype == 1)
+							local_error += std::fabs(dv);
+						else if (Ltype == 2)
+							local_error += dv * dv;
+					}
 					
 					if (Ltype == 1)
-						local_error += std::fabs(dv);
+						local_error = local_error * 0.1;
 					else if (Ltype == 2)
-						local_error += dv * dv;
+						local_error = std::sqrt(local_error * 0.1);
+					
+					if (max_error < local_error)
+						max_error = local_error;
 				}
-				
-				if (Ltype == 1)
-					local_error = local_error * 0.1;
-				else if (Ltype == 2)
-					local_error = std::sqrt(local_error * 0.1);
-				
-				if (max_error < local_error)
-					max_error = local_error;
 			}
 			
 			return max_error;
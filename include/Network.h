@@ -16,7 +16,82 @@ namespace NNSpace {
 		SIGMOID, 
 		BIPOLAR_SIGMOID, 
 		RELU, 
-		TANH
+		TANH,
+		// Approximate versions, see fast_tanh()
+		SIGMOID_FAST,
+		BIPOLAR_SIGMOID_FAST,
+		TANH_FAST
+	};
+	
+	// Fast approximation of tanh(t) used by the *_FAST activators.
+	// 7th order rational approximation (Lambert's continued fraction), input is clamped to [-4.8, 4.8].
+	// Contains no exp / branches and vectorizes.
+	// Maximal absolute error:
+	//  tanh(t)                  - 7.3e-5
+	//  sigmoid(t)               - 3.7e-5 (computed as 0.5 + 0.5 * tanh(t / 2))
+	//  bipolar sigmoid(t)       - 7.3e-5 (computed as tanh(t / 2))
+	//  derivative (1 - tanh^2)  - 1.5e-4
+	inline double fast_tanh(double t) {
+		t = t < -4.8 ? -4.8 : t > 4.8 ? 4.8 : t;
+		double t2 = t * t;
+		double r  = t * (135135.0 + t2 * (17325.0 + t2 * (378.0 + t2))) / (135135.0 + t2 * (62370.0 + t2 * (3150.0 + t2 * 28.0)));
+		return r < -1.0 ? -1.0 : r > 1.0 ? 1.0 : r;
+	};
+	
+	// Compile-time activator functions.
+	// Used to evaluate whole layer with single dispatch on ActivatorType instead of 
+	//  virtual call per neuron.
+	// process(t)    - activated value
+	// derivative(y) - derivative value, calculated from activated value y = process(t)
+	template<ActivatorType type>
+	struct Activator;
+	
+	template<>
+	struct Activator<ActivatorType::LINEAR> {
+		static inline double process(double t) { return t; };
+		static inline double derivative(double y) { return 1.0; };
+	};
+	
+	template<>
+	struct Activator<ActivatorType::SIGMOID> {
+		static inline double process(double t) { return 1 / (1 + std::exp(-t)); };
+		static inline double derivative(double y) { return y * (1 - y); };
+	};
+	
+	template<>
+	struct Activator<ActivatorType::BIPOLAR_SIGMOID> {
+		static inline double process(double t) { return 2 / (1 + std::exp(-t)) - 1; };
+		static inline double derivative(double y) { return 0.5 * (1 + y) * (1 - y); };
+	};
+	
+	template<>
+	struct Activator<ActivatorType::RELU> {
+		static inline double process(double t) { return t <= 0.0 ? 0.0 : t; };
+		static inline double derivative(double y) { return y <= 0.0 ? 0.0 : 1.0; };
+	};
+	
+	template<>
+	struct Activator<ActivatorType::TANH> {
+		static inline double process(double t) { return std::tanh(t); };
+		static inline double derivative(double y) { return 1 - y * y; };   // sech^2(x) == 1 - tanh^2(x)
+	};
+	
+	template<>
+	struct Activator<ActivatorType::SIGMOID_FAST> {
+		static inline double process(double t) { return 0.5 + 0.5 * fast_tanh(0.5 * t); };
+		static inline double derivative(double y) { return y * (1 - y); };
+	};
+	
+	template<>
+	struct Activator<ActivatorType::BIPOLAR_SIGMOID_FAST> {
+		static inline double process(double t) { return fast_tanh(0.5 * t); };
+		static inline double derivative(double y) { return 0.5 * (1 + y) * (1 - y); };
+	};
+	
+	template<>
+	struct Activator<ActivatorType::TANH_FAST> {
+		static inline double process(double t) { return fast_tanh(t); };
+		static inline double derivative(double y) { return 1 - y * y; };
 	};
 	
 	class NetworkFunction {
@@ -30,6 +105,7 @@ namespace NNSpace {
 		virtual double process(double t) { return 0; };
 		virtual double derivative(double t) { return 0; };
 		virtual NetworkFunction* clone() { return nullptr; };
+		virtual ~NetworkFunction() {};
 		ActivatorType getType() { return type; };
 	};
 
@@ -39,7 +115,7 @@ namespace NNSpace {
 	
 		Linear() { type = ActivatorType::LINEAR; };
 		
-		double process(double t) { return t; };
+		double process(double t) { return Activator<ActivatorType::LINEAR>::process(t); };
 		double derivative(double t) { return 1.0; };
 		virtual NetworkFunction* clone() { return new Linear(); };
 	};
@@ -50,8 +126,8 @@ namespace NNSpace {
 	
 		Sigmoid() { type = ActivatorType::SIGMOID; };
 		
-		double process(double t) { return 1 / (1 + std::exp(-t)); };
-		double derivative(double t) { return this->process(t) * (1 - this->process(t)); };
+		double process(double t) { return Activator<ActivatorType::SIGMOID>::process(t); };
+		double derivative(double t) { return Activator<ActivatorType::SIGMOID>::derivative(this->process(t)); };
 		virtual NetworkFunction* clone() { return new Sigmoid; };
 	};
 
@@ -61,8 +137,8 @@ namespace NNSpace {
 	
 		BipolarSigmoid() { type = ActivatorType::BIPOLAR_SIGMOID; };
 		
-		double process(double t) { return  2 / (1 + std::exp(-t)) - 1; };
-		double derivative(double t) { return 0.5 * (1 + this->process(t)) * (1 - this->process(t)); };
+		double process(double t) { return Activator<ActivatorType::BIPOLAR_SIGMOID>::process(t); };
+		double derivative(double t) { return Activator<ActivatorType::BIPOLAR_SIGMOID>::derivative(this->process(t)); };
 		virtual NetworkFunction* clone() { return new BipolarSigmoid(); };
 	};
 
@@ -72,7 +148,7 @@ namespace NNSpace {
 	
 		ReLU() { type = ActivatorType::RELU; };
 		
-		double process(double t) { return t <= 0.0 ? 0.0 : t; };
+		double process(double t) { return Activator<ActivatorType::RELU>::process(t); };
 		double derivative(double t) { return t <= 0.0 ? 0.0 : 1.0; };
 		virtual NetworkFunction* clone() { return new ReLU(); };
 	};
@@ -84,16 +160,93 @@ namespace NNSpace {
 		TanH() { type = ActivatorType::TANH; };
 		
 		double process(double t) {
-			return std::tanh(t); 
+			return Activator<ActivatorType::TANH>::process(t); 
 		};
 		
 		double derivative(double t) { 
-			double sh = 1.0 / std::cosh(t);   // sech(x) == 1/cosh(x)
-			return sh * sh;                   // sech^2(x)
+			return Activator<ActivatorType::TANH>::derivative(this->process(t));
 		};
 		virtual NetworkFunction* clone() { return new TanH(); };
 	};
 	
+	// Approximate Sigmoid, see fast_tanh() for error bounds
+	class FastSigmoid : public NetworkFunction {
+
+	public:
+	
+		FastSigmoid() { type = ActivatorType::SIGMOID_FAST; };
+		
+		double process(double t) { return Activator<ActivatorType::SIGMOID_FAST>::process(t); };
+		double derivative(double t) { return Activator<ActivatorType::SIGMOID_FAST>::derivative(this->process(t)); };
+		virtual NetworkFunction* clone() { return new FastSigmoid(); };
+	};
+	
+	// Approximate BipolarSigmoid, see fast_tanh() for error bounds
+	class FastBipolarSigmoid : public NetworkFunction {
+
+	public:
+	
+		FastBipolarSigmoid() { type = ActivatorType::BIPOLAR_SIGMOID_FAST; };
+		
+		double process(double t) { return Activator<ActivatorType::BIPOLAR_SIGMOID_FAST>::process(t); };
+		double derivative(double t) { return Activator<ActivatorType::BIPOLAR_SIGMOID_FAST>::derivative(this->process(t)); };
+		virtual NetworkFunction* clone() { return new FastBipolarSigmoid(); };
+	};
+	
+	// Approximate TanH, see fast_tanh() for error bounds
+	class FastTanH : public NetworkFunction {
+
+	public:
+	
+		FastTanH() { type = ActivatorType::TANH_FAST; };
+		
+		double process(double t) { return Activator<ActivatorType::TANH_FAST>::process(t); };
+		double derivative(double t) { return Activator<ActivatorType::TANH_FAST>::derivative(this->process(t)); };
+		virtual NetworkFunction* clone() { return new FastTanH(); };
+	};
+	
+	// out[i] = process(raw[i]), raw and out may be the same array
+	template<ActivatorType type>
+	inline void activate_layer(const double* raw, double* out, int n) {
+		for (int i = 0; i < n; ++i)
+			out[i] = Activator<type>::process(raw[i]);
+	};
+	
+	// sigma[i] *= derivative(out[i]), out is the activated layer values
+	template<ActivatorType type>
+	inline void multiply_derivative(const double* out, double* sigma, int n) {
+		for (int i = 0; i < n; ++i)
+			sigma[i] *= Activator<type>::derivative(out[i]);
+	};
+	
+	// Activate whole layer, dispatch on type once per layer
+	inline void activate_layer(ActivatorType type, const double* raw, double* out, int n) {
+		switch (type) {
+			case ActivatorType::LINEAR:          activate_layer<ActivatorType::LINEAR>         (raw, out, n); break;
+			case ActivatorType::SIGMOID:         activate_layer<ActivatorType::SIGMOID>        (raw, out, n); break;
+			case ActivatorType::BIPOLAR_SIGMOID: activate_layer<ActivatorType::BIPOLAR_SIGMOID>(raw, out, n); break;
+			case ActivatorType::RELU:            activate_layer<ActivatorType::RELU>           (raw, out, n); break;
+			case ActivatorType::TANH:            activate_layer<ActivatorType::TANH>           (raw, out, n); break;
+			case ActivatorType::SIGMOID_FAST:         activate_layer<ActivatorType::SIGMOID_FAST>        (raw, out, n); break;
+			case ActivatorType::BIPOLAR_SIGMOID_FAST: activate_layer<ActivatorType::BIPOLAR_SIGMOID_FAST>(raw, out, n); break;
+			case ActivatorType::TANH_FAST:            activate_layer<ActivatorType::TANH_FAST>           (raw, out, n); break;
+		}
+	};
+	
+	// Multiply layer sigma by activator derivative, dispatch on type once per layer
+	inline void multiply_derivative(ActivatorType type, const double* out, double* sigma, int n) {
+		switch (type) {
+			case ActivatorType::LINEAR:          multiply_derivative<ActivatorType::LINEAR>         (out, sigma, n); break;
+			case ActivatorType::SIGMOID:         multiply_derivative<ActivatorType::SIGMOID>        (out, sigma, n); break;
+			case ActivatorType::BIPOLAR_SIGMOID: multiply_derivative<ActivatorType::BIPOLAR_SIGMOID>(out, sigma, n); break;
+			case ActivatorType::RELU:            multiply_derivative<ActivatorType::RELU>           (out, sigma, n); break;
+			case ActivatorType::TANH:            multiply_derivative<ActivatorType::TANH>           (out, sigma, n); break;
+			case ActivatorType::SIGMOID_FAST:         multiply_derivative<ActivatorType::SIGMOID_FAST>        (out, sigma, n); break;
+			case ActivatorType::BIPOLAR_SIGMOID_FAST: multiply_derivative<ActivatorType::BIPOLAR_SIGMOID_FAST>(out, sigma, n); break;
+			case ActivatorType::TANH_FAST:            multiply_derivative<ActivatorType::TANH_FAST>           (out, sigma, n); break;
+		}
+	};
+	
 	inline static NetworkFunction* getActivatorByType(ActivatorType type) {
 		switch (type) {
 			case ActivatorType::LINEAR:          return new Linear();
@@ -101,6 +254,9 @@ namespace NNSpace {
 			case ActivatorType::BIPOLAR_SIGMOID: return new BipolarSigmoid();
 			case ActivatorType::RELU:            return new ReLU();
 			case ActivatorType::TANH:            return new TanH();
+			case ActivatorType::SIGMOID_FAST:         return new FastSigmoid();
+			case ActivatorType::BIPOLAR_SIGMOID_FAST: return new FastBipolarSigmoid();
+			case ActivatorType::TANH_FAST:            return new FastTanH();
 			default: return new Linear();
 		}
 	};
@@ -111,6 +267,9 @@ namespace NNSpace {
 		if (name == "BipolarSigmoid")  return new NNSpace::BipolarSigmoid();
 		if (name == "ReLU")            return new NNSpace::ReLU();
 		if (name == "TanH")            return new NNSpace::TanH();
+		if (name == "FastSigmoid")        return new NNSpace::FastSigmoid();
+		if (name == "FastBipolarSigmoid") return new NNSpace::FastBipolarSigmoid();
+		if (name == "FastTanH")           return new NNSpace::FastTanH();
 		return new Linear();
 	};
 	
@@ -0,0 +1,363 @@
+/*
+ * (c) Copyright bitrate16 (GPLv3.0) 2020
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fstream>
+
+#include "MultiLayerNetwork.h"
+#include "MappedFile.h"
+
+// Binary .neetwook network format.
+// Layout (little-endian):
+//  1. header: magic, version, amount of layers n, flags, size of file
+//  2. n layer sizes (int32)
+//  3. n - 1 activator ids (uint32)
+//  4. for each layer k: row-major weights W[k][i][j], then offsets of layer k + 1 (double),
+//     every blob starts at multiple of BLOB_ALIGNMENT bytes
+//  5. if MASK flag is set, active flag of every neuron of every layer (uint8)
+//  6. checksum of all preceding bytes (uint64)
+// Blobs are aligned, so the file can be mapped and weights used in place.
+namespace NNSpace {
+	namespace netfile {
+
+		// "NNBW"
+		const uint32_t MAGIC   = 0x57424E4E;
+		const uint32_t VERSION = 1;
+
+		// Alignment of weight blobs in file
+		const std::size_t BLOB_ALIGNMENT = 64;
+
+		// Header flags
+		enum Flags {
+			OFFSETS = 1,
+			// Network has disabled neurons
+			MASK    = 2
+		};
+
+		struct Header {
+			uint32_t magic;
+			uint32_t version;
+			uint32_t layers;
+			uint32_t flags;
+			uint64_t size;
+		};
+
+		// Format is defined as little-endian, data is written as is
+		const bool HOST_LITTLE_ENDIAN = __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__;
+
+		inline std::size_t align(std::size_t pos) {
+			return (pos + BLOB_ALIGNMENT - 1) / BLOB_ALIGNMENT * BLOB_ALIGNMENT;
+		};
+
+		// 64-bit FNV-1a over 8-byte words with 4 independent lanes, tail is hashed by bytes
+		uint64_t checksum(const void* data, std::size_t size) {
+			const uint64_t PRIME = 0x100000001B3ULL;
+			uint64_t h[4] = { 0xCBF29CE484222325ULL, 0x84222325CBF29CE4ULL, 0xE484222325CBF29CULL, 0x22325CBF29CE4842ULL };
+
+			const unsigned char* p = static_cast<const unsigned char*>(data);
+			std::size_t n = size / 32;
+
+			for (std::size_t i = 0; i < n; ++i, p += 32)
+				for (int l = 0; l < 4; ++l) {
+					uint64_t w;
+					std::memcpy(&w, p + l * 8, 8);
+					h[l] = (h[l] ^ w) * PRIME;
+				}
+
+			uint64_t r = h[0];
+			for (int l = 1; l < 4; ++l)
+				r = (r ^ h[l]) * PRIME;
+
+			for (std::size_t i = n * 32; i < size; ++i)
+				r = (r ^ *p++) * PRIME;
+
+			return (r ^ size) * PRIME;
+		};
+
+		// Position of each blob in file
+		struct Layout {
+			// Position of layer sizes
+			std::size_t dimensions;
+			// Position of activator ids
+			std::size_t activators;
+			// Position of weights and offsets of each layer
+			std::vector<std::size_t> weights;
+			std::vector<std::size_t> offsets;
+			// Position of neuron mask, 0 if none
+			std::size_t mask = 0;
+			// Position of checksum
+			std::size_t checksum;
+			// Total file size
+			std::size_t size;
+
+			Layout(const std::vector<int>& dim, bool masked = 0) {
+				int L = dim.size() - 1;
+
+				dimensions = sizeof(Header);
+				activators = dimensions + dim.size() * sizeof(int32_t);
+
+				std::size_t pos = activators + L * sizeof(uint32_t);
+				weights.resize(L);
+				offsets.resize(L);
+
+				for (int k = 0; k < L; ++k) {
+					weights[k] = align(pos);
+					pos = weights[k] + (std::size_t) dim[k] * dim[k + 1] * sizeof(double);
+					offsets[k] = align(pos);
+					pos = offsets[k] + (std::size_t) dim[k + 1] * sizeof(double);
+				}
+
+				if (masked) {
+					mask = align(pos);
+					pos  = mask;
+					for (int d : dim)
+						pos += d;
+				}
+
+				checksum = align(pos);
+				size     = checksum + sizeof(uint64_t);
+			};
+		};
+
+		// Write network in binary format.
+		// Returns 0 on failture
+		bool write(const NNSpace::MLNet& net, const std::string& path) {
+			if (!HOST_LITTLE_ENDIAN || net.dimensions.size() < 2)
+				return 0;
+
+			bool masked = net.masked();
+			Layout l(net.dimensions, masked);
+			int L = net.dimensions.size() - 1;
+
+			std::vector<char> data(l.size, 0);
+
+			uint32_t flags = (net.enable_offsets ? (uint32_t) OFFSETS : 0u) | (masked ? (uint32_t) MASK : 0u);
+			Header h = { MAGIC, VERSION, (uint32_t) net.dimensions.size(), flags, (uint64_t) l.size };
+			std::memcpy(data.data(), &h, sizeof(h));
+
+			for (int k = 0; k <= L; ++k) {
+				int32_t d = net.dimensions[k];
+				std::memcpy(data.data() + l.dimensions + k * sizeof(int32_t), &d, sizeof(d));
+			}
+
+			for (int k = 0; k < L; ++k) {
+				uint32_t a = net.activators[k]->getType();
+				std::memcpy(data.data() + l.activators + k * sizeof(uint32_t), &a, sizeof(a));
+			}
+
+			for (int k = 0; k < L; ++k) {
+				double* w = reinterpret_cast<double*>(data.data() + l.weights[k]);
+
+				if (net.W[k].layout == ROW_MAJOR)
+					std::memcpy(w, net.W[k].raw(), net.W[k].size() * sizeof(double));
+				else
+					for (int i = 0; i < net.W[k].rows; ++i)
+						for (int j = 0; j < net.W[k].cols; ++j)
+							w[(std::size_t) i * net.W[k].cols + j] = net.W[k].at(i, j);
+
+				std::memcpy(data.data() + l.offsets[k], net.offsets[k].data(), net.offsets[k].size() * sizeof(double));
+			}
+
+			if (masked)
+				for (int k = 0, n = 0; k <= L; ++k)
+					for (int i = 0; i < net.dimensions[k]; ++i)
+						data[l.mask + n++] = net.isActive(k, i);
+
+			uint64_t sum = checksum(data.data(), l.checksum);
+			std::memcpy(data.data() + l.checksum, &sum, sizeof(sum));
+
+			std::ofstream of(path, std::ios::binary | std::ios::trunc);
+			if (!of)
+				return 0;
+
+			of.write(data.data(), data.size());
+			return (bool) of;
+		};
+
+		// Read-only memory mapping of binary network file.
+		// Weights are accessed in place without copying.
+		class MappedNetwork {
+
+			MappedFile file;
+			const char* data = nullptr;
+
+			void unmap() {
+				file.close();
+				data = nullptr;
+			};
+
+		public:
+
+			// Topology of the network
+			std::vector<int> dimensions;
+			// Activator of each layer
+			std::vector<ActivatorType> types;
+			// Offsets flag
+			bool enable_offsets = 0;
+			// Position of each blob
+			std::vector<std::size_t> weights_pos;
+			std::vector<std::size_t> offsets_pos;
+			// Position of neuron mask, 0 if none
+			std::size_t mask_pos = 0;
+
+			MappedNetwork() {};
+
+			MappedNetwork(const std::string& path, bool verify = 1) {
+				open(path, verify);
+			};
+
+			MappedNetwork(const MappedNetwork&) = delete;
+
+			MappedNetwork& operator=(const MappedNetwork&) = delete;
+
+			~MappedNetwork() {
+				unmap();
+			};
+
+			// Map file and validate header and blob sizes.
+			// verify - validate checksum of the whole file
+			// Returns 0 on failture
+			bool open(const std::string& path, bool verify = 1) {
+				unmap();
+
+				if (!HOST_LITTLE_ENDIAN)
+					return 0;
+
+				if (!file.open(path) || file.size() < sizeof(Header))
+					return 0;
+
+				data = file.data();
+				std::size_t length = file.size();
+
+				Header h;
+				std::memcpy(&h, data, sizeof(h));
+				if (h.magic != MAGIC || h.version != VERSION || h.size != length || h.layers < 2 || h.layers > (1 << 16)
+					|| sizeof(Header) + h.layers * (sizeof(int32_t) + sizeof(uint32_t)) > length) {
+					unmap();
+					return 0;
+				}
+
+				dimensions.resize(h.layers);
+				for (int k = 0; k < h.layers; ++k) {
+					int32_t d;
+					std::memcpy(&d, data + sizeof(Header) + k * sizeof(int32_t), sizeof(d));
+					if (d <= 0) {
+						unmap();
+						return 0;
+					}
+					dimensions[k] = d;
+				}
+
+				Layout l(dimensions, h.flags & MASK);
+				if (l.size != length) {
+					unmap();
+					return 0;
+				}
+
+				types.resize(h.layers - 1);
+				for (int k = 0; k < h.layers - 1; ++k) {
+					uint32_t a;
+					std::memcpy(&a, data + l.activators + k * sizeof(uint32_t), sizeof(a));
+					types[k] = (ActivatorType) a;
+				}
+
+				if (verify) {
+					uint64_t sum;
+					std::memcpy(&sum, data + l.checksum, sizeof(sum));
+					if (sum != checksum(data, l.checksum)) {
+						unmap();
+						return 0;
+					}
+				}
+
+				// Input neurons can not be disabled
+				if (l.mask)
+					for (int i = 0; i < dimensions[0]; ++i)
+						if (!data[l.mask + i]) {
+							unmap();
+							return 0;
+						}
+
+				enable_offsets = h.flags & OFFSETS;
+				weights_pos    = l.weights;
+				offsets_pos    = l.offsets;
+				mask_pos       = l.mask;
+
+				return 1;
+			};
+
+			inline bool is_open() const { return data; };
+
+			// Row-major weights of layer k, W[k][i][j] at i * dimensions[k + 1] + j
+			inline const double* weights(int k) const {
+				return reinterpret_cast<const double*>(data + weights_pos[k]);
+			};
+
+			// Offsets of layer k
+			inline const double* offsets(int k) const {
+				return reinterpret_cast<const double*>(data + offsets_pos[k]);
+			};
+
+			// Active flags of all neurons of all layers one after another, nullptr if network has no mask
+			inline const uint8_t* mask() const {
+				return mask_pos ? reinterpret_cast<const uint8_t*>(data + mask_pos) : nullptr;
+			};
+
+			// Copy mapped network into net
+			bool to_network(NNSpace::MLNet& net) const {
+				if (!data)
+					return 0;
+
+				net.set(dimensions);
+				net.enable_offsets = enable_offsets;
+
+				for (int k = 0; k < types.size(); ++k) {
+					delete net.activators[k];
+					net.activators[k] = getActivatorByType(types[k]);
+				}
+
+				for (int k = 0; k < types.size(); ++k) {
+					if (net.W[k].layout == ROW_MAJOR)
+						std::memcpy(net.W[k].raw(), weights(k), net.W[k].size() * sizeof(double));
+					else
+						for (int i = 0; i < net.W[k].rows; ++i)
+							for (int j = 0; j < net.W[k].cols; ++j)
+								net.W[k].at(i, j) = weights(k)[(std::size_t) i * net.W[k].cols + j];
+
+					std::memcpy(net.offsets[k].data(), offsets(k), net.offsets[k].size() * sizeof(double));
+				}
+
+				if (mask())
+					for (int k = 0, n = 0; k < dimensions.size(); ++k)
+						for (int i = 0; i < dimensions[k]; ++i)
+							if (!mask()[n++])
+								net.setActive(k, i, 0);
+
+				net.sparsify();
+
+				return 1;
+			};
+		};
+
+		// Read binary network file into net
+		// Returns 0 on failture
+		bool read(NNSpace::MLNet& net, const std::string& path) {
+			MappedNetwork map(path);
+			return map.to_network(net);
+		};
+
+		// Check if file starts with binary format magic
+		bool is_binary(const std::string& path) {
+			std::ifstream is(path, std::ios::binary);
+			uint32_t magic = 0;
+			is.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+			return is && magic == MAGIC;
+		};
+	};
+};
@@ -0,0 +1,82 @@
+/*
+ * (c) Copyright bitrate16 (GPLv3.0) 2020
+ */
+
+#pragma once
+
+#include <vector>
+#include <algorithm>
+
+#include "MultiLayerNetwork.h"
+
+namespace NNSpace {
+
+	// Population of networks used by multistart with per-network state stored as structure of arrays.
+	// Networks and their state are addressed by id and never move after creation,
+	//  alive networks are listed in active, so pruning only compacts the list of ids.
+	struct Population {
+		// Networks by id
+		std::vector<NNSpace::MLNet> networks;
+		// Training rate value by id
+		std::vector<double> rates;
+		// Testing error value by id
+		// a - before train
+		// b - after train
+		// d - error delta
+		std::vector<double> errors_a;
+		std::vector<double> errors_b;
+		std::vector<double> errors_d;
+		// Ids of alive networks
+		std::vector<int> active;
+
+		Population() {};
+
+		// Take ownership of networks and init state of each with the given values
+		Population(std::vector<NNSpace::MLNet>&& nets, double rate = 0.5, double error = 0.5) {
+			reset(std::move(nets), rate, error);
+		};
+
+		void reset(std::vector<NNSpace::MLNet>&& nets, double rate = 0.5, double error = 0.5) {
+			networks = std::move(nets);
+			rates   .assign(networks.size(), rate);
+			errors_a.assign(networks.size(), error);
+			errors_b.assign(networks.size(), error);
+			errors_d.assign(networks.size(), error);
+
+			active.resize(networks.size());
+			for (int i = 0; i < active.size(); ++i)
+				active[i] = i;
+		};
+
+		// Amount of alive networks
+		inline int size() const { return active.size(); };
+
+		// Network at position i of alive list
+		inline NNSpace::MLNet& operator[](int i) { return networks[active[i]]; };
+
+		inline const NNSpace::MLNet& operator[](int i) const { return networks[active[i]]; };
+
+		// Remove networks at the given positions of alive list in single pass, order of the rest is kept
+		void remove(const std::vector<int>& positions) {
+			std::vector<char> removed(active.size(), 0);
+			for (int i : positions)
+				removed[i] = 1;
+
+			int n = 0;
+			for (int i = 0; i < active.size(); ++i)
+				if (removed[i])
+					release(active[i]);
+				else
+					active[n++] = active[i];
+
+			active.resize(n);
+		};
+
+	private:
+
+		// Free memory of removed network
+		void release(int id) {
+			NNSpace::MLNet().swap(networks[id]);
+		};
+	};
+};
@@ -0,0 +1,244 @@
+/*
+ * (c) Copyright bitrate16 (GPLv3.0) 2020
+ */
+
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <functional>
+
+#include "MultiLayerNetwork.h"
+#include "ThreadPool.h"
+
+namespace NNSpace {
+
+	// Incremental evaluation of network without single hidden neuron on fixed set of inputs.
+	// Activations of hidden layers and raw sums of following layers are cached for every sample,
+	//  so removal of neuron j of layer k is rank-1 correction of layer k + 1 sums:
+	//  sums[k + 1][b][c] - values[k][b][j] * W[k][j][c],
+	//  and only layers after k are calculated again.
+	// Removed neurons are disabled in network mask, MLNet::compact() drops them after reduction.
+	class ReductionEngine {
+
+		MLNet& net;
+		// Amount of samples
+		int count;
+		// values[k] - count rows of activated layer k values, for hidden layers
+		std::vector<std::vector<double>> values;
+		// sums[k] - count rows of raw layer k values, for layers after first hidden
+		std::vector<std::vector<double>> sums;
+
+		// Calculate layers after k from values of layer k (count rows), update cache
+		void propagate(int k, const double* in) {
+			int L = net.dimensions.size();
+
+			for (; k < L - 1; ++k) {
+				int size = net.dimensions[k + 1];
+				std::vector<double> out((std::size_t) count * size);
+
+				if (net.enable_offsets)
+					for (int b = 0; b < count; ++b)
+						std::copy(net.offsets[k].begin(), net.offsets[k].end(), out.begin() + (std::size_t) b * size);
+
+				net.W[k].multiply_batch(in, count, out.data());
+
+				if (k + 1 >= 2)
+					sums[k + 1] = out;
+
+				if (k + 1 == L - 1)
+					break;
+
+				activate_layer(net.activators[k]->getType(), out.data(), out.data(), out.size());
+				net.mask_layer(k + 1, out.data(), count);
+				values[k + 1].swap(out);
+				in = values[k + 1].data();
+			}
+		};
+
+		// Activate raw layer k values in layer and calculate output layer values into outputs
+		void forward(int k, std::vector<double>& layer, double* outputs) const {
+			int L = net.dimensions.size();
+			std::vector<double> next;
+
+			for (;; ++k) {
+				double* out = (k == L - 1) ? outputs : layer.data();
+				activate_layer(net.activators[k - 1]->getType(), layer.data(), out, (std::size_t) count * net.dimensions[k]);
+				net.mask_layer(k, out, count);
+
+				if (k == L - 1)
+					return;
+
+				int size = net.dimensions[k + 1];
+				next.assign((std::size_t) count * size, 0.0);
+
+				if (net.enable_offsets)
+					for (int b = 0; b < count; ++b)
+						std::copy(net.offsets[k].begin(), net.offsets[k].end(), next.begin() + (std::size_t) b * size);
+
+				net.W[k].multiply_batch(layer.data(), count, next.data());
+				layer.swap(next);
+			}
+		};
+
+	public:
+
+		// Neuron j of hidden layer k
+		struct Candidate {
+			int k;
+			int j;
+		};
+
+		// net    - network to reduce, must not be changed outside of engine while it is used
+		// inputs - count rows of input layer size
+		ReductionEngine(MLNet& net, const double* inputs, int count) : net(net), count(count) {
+			values.resize(net.dimensions.size());
+			sums.resize(net.dimensions.size());
+			propagate(0, inputs);
+		};
+
+		// Amount of samples
+		inline int size() const { return count; };
+
+		// Calculate output layer values of network without neuron j of hidden layer k
+		// outputs - count rows of output layer size
+		void run_without(int k, int j, double* outputs) const {
+			int prev = net.dimensions[k];
+			int size = net.dimensions[k + 1];
+
+			// Outcoming weights of neuron
+			std::vector<double> w(size);
+			for (int c = 0; c < size; ++c)
+				w[c] = net.W[k][j][c];
+
+			const double* a = values[k].data();
+			const double* s = sums[k + 1].data();
+			std::vector<double> layer((std::size_t) count * size);
+
+			for (int b = 0; b < count; ++b) {
+				double v = a[(std::size_t) b * prev + j];
+				for (int c = 0; c < size; ++c)
+					layer[(std::size_t) b * size + c] = s[(std::size_t) b * size + c] - v * w[c];
+			}
+
+			forward(k + 1, layer, outputs);
+		};
+
+		// Score network without each of candidates, scores[c] = metric(outputs without candidates[c]).
+		// Candidates are scored in parallel on pool, engine and network are only read,
+		//  so every task works on its own outputs buffer and metric must be safe to call concurrently.
+		void score(const std::vector<Candidate>& candidates, const std::function<double(const double*)>& metric, std::vector<double>& scores, ThreadPool& pool) const {
+			scores.resize(candidates.size());
+			std::size_t size = (std::size_t) count * net.dimensions.back();
+
+			pool.parallel_for(candidates.size(), [&](int c) {
+				std::vector<double> outputs(size);
+				run_without(candidates[c].k, candidates[c].j, outputs.data());
+				scores[c] = metric(outputs.data());
+			});
+		};
+
+		// Calculate output layer values of network without all removed neurons at once.
+		// Layers after first layer of removed neurons are calculated again.
+		void run_without(const std::vector<Candidate>& removed, double* outputs) const {
+			int L = net.dimensions.size();
+			int k = L;
+			for (const Candidate& c : removed)
+				k = std::min(k, c.k);
+
+			// Zero neurons of layer k in activated values
+			auto zero = [&removed, this](int k, double* layer) {
+				int size = net.dimensions[k];
+				for (const Candidate& c : removed)
+					if (c.k == k)
+						for (int b = 0; b < count; ++b)
+							layer[(std::size_t) b * size + c.j] = 0.0;
+			};
+
+			std::vector<double> layer(values[k]);
+			std::vector<double> next;
+			zero(k, layer.data());
+
+			for (;; ++k) {
+				int size = net.dimensions[k + 1];
+				double* out = outputs;
+
+				if (k + 1 != L - 1) {
+					next.resize((std::size_t) count * size);
+					out = next.data();
+				}
+
+				if (net.enable_offsets)
+					for (int b = 0; b < count; ++b)
+						std::copy(net.offsets[k].begin(), net.offsets[k].end(), out + (std::size_t) b * size);
+				else
+					std::fill(out, out + (std::size_t) count * size, 0.0);
+
+				net.W[k].multiply_batch(layer.data(), count, out);
+				activate_layer(net.activators[k]->getType(), out, out, (std::size_t) count * size);
+				net.mask_layer(k + 1, out, count);
+
+				if (k + 1 == L - 1)
+					return;
+
+				zero(k + 1, out);
+				layer.swap(next);
+			}
+		};
+
+		// Pick up to amount candidates with the lowest impact, better(a, b) - score a has lower impact than score b.
+		// At least one neuron is left active in every layer.
+		std::vector<Candidate> select(const std::vector<Candidate>& candidates, const std::vector<double>& scores, int amount, const std::function<bool(double, double)>& better) const {
+			std::vector<int> order(candidates.size());
+			for (int c = 0; c < order.size(); ++c)
+				order[c] = c;
+
+			std::stable_sort(order.begin(), order.end(), [&scores, &better](int a, int b) {
+				return better(scores[a], scores[b]);
+			});
+
+			std::vector<int> left(net.dimensions.size());
+			for (int k = 1; k < net.dimensions.size() - 1; ++k)
+				left[k] = net.activeCount(k) - 1;
+
+			std::vector<Candidate> selected;
+			for (int c : order) {
+				if (selected.size() == amount)
+					break;
+
+				if (left[candidates[c].k] > 0) {
+					--left[candidates[c].k];
+					selected.push_back(candidates[c]);
+				}
+			}
+
+			return selected;
+		};
+
+		// Disable neuron j of hidden layer k in network and update cache
+		void remove(int k, int j) {
+			remove(std::vector<Candidate>{ { k, j } });
+		};
+
+		// Disable all removed neurons in network and update cache
+		void remove(const std::vector<Candidate>& removed) {
+			if (removed.empty())
+				return;
+
+			int k = net.dimensions.size();
+			for (const Candidate& c : removed) {
+				net.setActive(c.k, c.j, 0);
+				k = std::min(k, c.k);
+			}
+
+			int size = net.dimensions[k];
+			for (const Candidate& c : removed)
+				if (c.k == k)
+					for (int b = 0; b < count; ++b)
+						values[k][(std::size_t) b * size + c.j] = 0.0;
+
+			// Layers after k are calculated without the neurons
+			propagate(k, values[k].data());
+		};
+	};
+};
@@ -0,0 +1,149 @@
+/*
+ * (c) Copyright bitrate16 (GPLv3.0) 2020
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fstream>
+
+#include "MappedFile.h"
+
+// Binary columnar .mset approximation set format.
+// Layout (little-endian):
+//  1. header: magic, version, amount of points, size of X, size of file
+//  2. X_size columns of X values, then column of Y values (double),
+//     every column starts at multiple of COLUMN_ALIGNMENT bytes
+// Columns are aligned, so the file can be mapped and used in place.
+namespace NNSpace {
+	namespace setfile {
+
+		// "NNST"
+		const uint32_t MAGIC   = 0x54534E4E;
+		const uint32_t VERSION = 1;
+
+		// Alignment of columns in file
+		const std::size_t COLUMN_ALIGNMENT = 64;
+
+		struct Header {
+			uint32_t magic;
+			uint32_t version;
+			uint64_t count;
+			uint32_t x_size;
+			uint32_t reserved;
+			uint64_t size;
+		};
+
+		// Format is defined as little-endian, data is written as is
+		const bool HOST_LITTLE_ENDIAN = __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__;
+
+		// Position of column c in file, column x_size is Y
+		inline std::size_t column(std::size_t count, int c) {
+			std::size_t stride = (count * sizeof(double) + COLUMN_ALIGNMENT - 1) / COLUMN_ALIGNMENT * COLUMN_ALIGNMENT;
+			return COLUMN_ALIGNMENT + stride * c;
+		};
+
+		// Total size of file
+		inline std::size_t file_size(std::size_t count, int x_size) {
+			return column(count, x_size) + count * sizeof(double);
+		};
+
+		// Writes set column by column
+		// x - x_size columns of count values
+		// y - column of count values
+		// Returns 0 on failture
+		bool write(const std::string& path, std::size_t count, int x_size, const std::vector<const double*>& x, const double* y) {
+			if (!HOST_LITTLE_ENDIAN)
+				return 0;
+
+			std::ofstream of(path, std::ios::binary | std::ios::trunc);
+			if (!of)
+				return 0;
+
+			std::vector<char> header(COLUMN_ALIGNMENT, 0);
+			Header h = { MAGIC, VERSION, (uint64_t) count, (uint32_t) x_size, 0, (uint64_t) file_size(count, x_size) };
+			std::memcpy(header.data(), &h, sizeof(h));
+			of.write(header.data(), header.size());
+
+			std::vector<char> padding(COLUMN_ALIGNMENT, 0);
+			for (int c = 0; c <= x_size; ++c) {
+				std::size_t pad = column(count, c) - (c ? column(count, c - 1) + count * sizeof(double) : COLUMN_ALIGNMENT);
+				of.write(padding.data(), pad);
+				of.write(reinterpret_cast<const char*>(c < x_size ? x[c] : y), count * sizeof(double));
+			}
+
+			return (bool) of;
+		};
+
+		// Read-only memory mapping of binary set file.
+		// Columns are accessed in place without copying.
+		class MappedSet {
+
+			MappedFile file;
+
+		public:
+
+			// Amount of points
+			std::size_t count = 0;
+			// Size of X
+			int x_size = 0;
+
+			MappedSet() {};
+
+			MappedSet(const std::string& path) {
+				open(path);
+			};
+
+			// Map file and validate header
+			// Returns 0 on failture
+			bool open(const std::string& path) {
+				count  = 0;
+				x_size = 0;
+
+				if (!HOST_LITTLE_ENDIAN || !file.open(path) || file.size() < sizeof(Header))
+					return 0;
+
+				Header h;
+				std::memcpy(&h, file.data(), sizeof(h));
+
+				if (h.magic != MAGIC || h.version != VERSION || h.x_size > (1 << 16) || h.count > file.size()
+					|| h.size != file.size() || file_size(h.count, h.x_size) != file.size()) {
+					file.close();
+					return 0;
+				}
+
+				count  = h.count;
+				x_size = h.x_size;
+				return 1;
+			};
+
+			inline bool is_open() const { return file.is_open(); };
+
+			// Hint that set will be read sequentially
+			void sequential() const {
+				file.sequential();
+			};
+
+			// Column of X[k] values
+			inline const double* x(int k) const {
+				return reinterpret_cast<const double*>(file.data() + column(count, k));
+			};
+
+			// Column of Y values
+			inline const double* y() const {
+				return reinterpret_cast<const double*>(file.data() + column(count, x_size));
+			};
+		};
+
+		// Check if file starts with binary format magic
+		bool is_binary(const std::string& path) {
+			std::ifstream is(path, std::ios::binary);
+			uint32_t magic = 0;
+			is.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+			return is && magic == MAGIC;
+		};
+	};
+};
@@ -0,0 +1,89 @@
+/*
+ * (c) Copyright bitrate16 (GPLv3.0) 2020
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "WeightMatrix.h"
+#include "kernels/sparse.h"
+
+namespace NNSpace {
+
+	// Layers with lower fraction of non-zero weights are evaluated in sparse form
+	const double SPARSE_DENSITY = 0.15;
+
+	// Non-zero weights of a single layer in CSR format by rows of input neurons.
+	// rows - size of input layer (i)
+	// cols - size of output layer (j)
+	// Read-only copy of WeightMatrix used for evaluation, built again after weights are changed.
+	class SparseMatrix {
+
+	public:
+
+		// rows + 1 positions, weights of input neuron i are at [starts[i], starts[i + 1]), empty if not built
+		std::vector<int> starts;
+		// Output neuron of each weight
+		std::vector<int> columns;
+		// Weights
+		std::vector<double> values;
+		// Amount of input neurons
+		int rows = 0;
+		// Amount of output neurons
+		int cols = 0;
+
+		SparseMatrix() {};
+
+		SparseMatrix(const WeightMatrix& W) {
+			assign(W);
+		};
+
+		// Copy non-zero weights of W
+		void assign(const WeightMatrix& W) {
+			rows = W.rows;
+			cols = W.cols;
+
+			starts.assign(rows + 1, 0);
+			columns.clear();
+			values.clear();
+
+			for (int i = 0; i < rows; ++i) {
+				for (int j = 0; j < cols; ++j) {
+					double w = W.at(i, j);
+					if (w != 0.0) {
+						columns.push_back(j);
+						values.push_back(w);
+					}
+				}
+
+				starts[i + 1] = values.size();
+			}
+		};
+
+		void clear() {
+			starts.clear();
+			columns.clear();
+			values.clear();
+			rows = 0;
+			cols = 0;
+		};
+
+		inline bool empty() const { return starts.empty(); };
+
+		// Amount of stored weights
+		inline std::size_t nonzeros() const { return values.size(); };
+
+		// Forward pass, out[j] += SUM [in[i] * W[i][j]]
+		void multiply(const double* in, double* out) const {
+			kernels::csr_gemv(starts.data(), columns.data(), values.data(), rows, in, out);
+		};
+
+		// Forward pass for batch of inputs, in is batch rows of size rows, out is batch rows of size cols
+		// out[b][j] += SUM [in[b][i] * W[i][j]]
+		void multiply_batch(const double* in, int batch, double* out) const {
+			kernels::csr_gemm(in, starts.data(), columns.data(), values.data(), out, batch, rows, cols);
+		};
+	};
+};
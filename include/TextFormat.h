@@ -0,0 +1,212 @@
+/*
+ * (c) Copyright bitrate16 (GPLv3.0) 2020
+ */
+
+#pragma once
+
+#include <charconv>
+#include <istream>
+#include <ostream>
+#include <vector>
+#include <cstring>
+
+// Buffered text number I/O built on std::to_chars / std::from_chars.
+// Doubles are written in shortest form that parses back to the same value,
+//  so text save / load is lossless.
+namespace NNSpace {
+	namespace text {
+
+		// Size of I/O chunk
+		const std::size_t CHUNK_SIZE = 1 << 20;
+
+		// Buffered writer of numbers into stream
+		class Writer {
+
+			std::ostream& os;
+			std::vector<char> buffer;
+			std::size_t pos = 0;
+
+			// Ensure space for n chars
+			inline void reserve(std::size_t n) {
+				if (pos + n > buffer.size())
+					flush();
+			};
+
+		public:
+
+			Writer(std::ostream& os) : os(os), buffer(CHUNK_SIZE) {};
+
+			Writer(const Writer&) = delete;
+
+			Writer& operator=(const Writer&) = delete;
+
+			~Writer() {
+				flush();
+			};
+
+			inline Writer& put(double v) {
+				reserve(32);
+				pos = std::to_chars(buffer.data() + pos, buffer.data() + buffer.size(), v).ptr - buffer.data();
+				return *this;
+			};
+
+			inline Writer& put(int v) {
+				reserve(16);
+				pos = std::to_chars(buffer.data() + pos, buffer.data() + buffer.size(), v).ptr - buffer.data();
+				return *this;
+			};
+
+			inline Writer& put(char c) {
+				reserve(1);
+				buffer[pos++] = c;
+				return *this;
+			};
+
+			inline Writer& put(const char* str) {
+				std::size_t n = std::strlen(str);
+				reserve(n);
+				if (n > buffer.size()) {
+					os.write(str, n);
+					return *this;
+				}
+
+				std::memcpy(buffer.data() + pos, str, n);
+				pos += n;
+				return *this;
+			};
+
+			// Write buffered data into stream
+			void flush() {
+				if (pos)
+					os.write(buffer.data(), pos);
+				pos = 0;
+			};
+		};
+
+		// Buffered reader of whitespace separated numbers from stream.
+		// Stream is read by chunks, unused data is returned to stream by finish() if it is seekable.
+		class Reader {
+
+			std::istream& is;
+			std::vector<char> buffer;
+			// Parse position and end of data in buffer
+			std::size_t pos = 0;
+			std::size_t end = 0;
+			// Stream is read to the end
+			bool eof = 0;
+
+			inline static bool space(char c) {
+				return c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == '\v' || c == '\f';
+			};
+
+			// Move unparsed data to the beginning and read next chunk
+			bool fill() {
+				if (eof)
+					return 0;
+
+				std::memmove(buffer.data(), buffer.data() + pos, end - pos);
+				end -= pos;
+				pos  = 0;
+
+				if (end == buffer.size())
+					buffer.resize(buffer.size() * 2);
+
+				is.read(buffer.data() + end, buffer.size() - end);
+				std::size_t n = is.gcount();
+				end += n;
+
+				if (n == 0 || !is) {
+					eof = 1;
+					is.clear(is.rdstate() & ~(std::ios::failbit | std::ios::eofbit));
+				}
+
+				return n;
+			};
+
+			// Skip spaces and make sure the whole token is in buffer
+			bool token() {
+				while (1) {
+					while (pos < end && space(buffer[pos]))
+						++pos;
+
+					if (pos < end) {
+						std::size_t e = pos;
+						while (e < end && !space(buffer[e]))
+							++e;
+
+						if (e < end || eof)
+							return 1;
+					}
+
+					if (!fill())
+						return pos < end;
+				}
+			};
+
+			template<typename T>
+			bool parse(T& v) {
+				if (fail || !token()) {
+					fail = 1;
+					return 0;
+				}
+
+				auto r = std::from_chars(buffer.data() + pos, buffer.data() + end, v);
+				if (r.ec != std::errc()) {
+					fail = 1;
+					return 0;
+				}
+
+				pos = r.ptr - buffer.data();
+				return 1;
+			};
+
+		public:
+
+			// Set if any read failed
+			bool fail = 0;
+
+			Reader(std::istream& is) : is(is), buffer(CHUNK_SIZE) {};
+
+			Reader(const Reader&) = delete;
+
+			Reader& operator=(const Reader&) = delete;
+
+			~Reader() {
+				finish();
+			};
+
+			inline bool get(double& v) { return parse(v); };
+
+			inline bool get(int& v) { return parse(v); };
+
+			inline bool get(bool& v) {
+				int i = 0;
+				if (!parse(i))
+					return 0;
+				v = i;
+				return 1;
+			};
+
+			// Skip next token if it is equal to word.
+			// Returns 0 if next token differs or there is no data left.
+			bool skip(const char* word) {
+				if (fail || !token())
+					return 0;
+
+				std::size_t n = std::strlen(word);
+				if (end - pos < n || std::memcmp(buffer.data() + pos, word, n) || (pos + n < end && !space(buffer[pos + n])))
+					return 0;
+
+				pos += n;
+				return 1;
+			};
+
+			// Return unparsed data to stream
+			void finish() {
+				if (end > pos)
+					is.seekg(-(std::streamoff) (end - pos), std::ios::cur);
+				pos = end = 0;
+			};
+		};
+	};
+};
@@ -0,0 +1,147 @@
+/*
+ * (c) Copyright bitrate16 (GPLv3.0) 2020
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace NNSpace {
+
+	// Fixed size pool of worker threads.
+	// Tasks are taken from the shared queue, parallel_for() hands out
+	//  indices dynamically so idle threads pick up the remaining work.
+	class ThreadPool {
+
+		std::vector<std::thread> workers;
+		std::deque<std::function<void()>> tasks;
+		std::mutex lock;
+		std::condition_variable cv;
+		bool stop = 0;
+
+		void worker() {
+			while (1) {
+				std::function<void()> task;
+
+				{
+					std::unique_lock<std::mutex> guard(lock);
+					cv.wait(guard, [this] { return stop || tasks.size(); });
+
+					if (stop && tasks.empty())
+						return;
+
+					task = std::move(tasks.front());
+					tasks.pop_front();
+				}
+
+				task();
+			}
+		};
+
+	public:
+
+		// threads - total amount of threads including the calling one, 0 for hardware concurrency
+		ThreadPool(int threads = 0) {
+			if (threads <= 0)
+				threads = std::max(1u, std::thread::hardware_concurrency());
+
+			// Calling thread participates in parallel_for, so it is counted too
+			for (int i = 0; i < threads - 1; ++i)
+				workers.emplace_back(&ThreadPool::worker, this);
+		};
+
+		ThreadPool(const ThreadPool&) = delete;
+
+		ThreadPool& operator=(const ThreadPool&) = delete;
+
+		~ThreadPool() {
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				stop = 1;
+			}
+
+			cv.notify_all();
+			for (auto& t : workers)
+				t.join();
+		};
+
+		// Total amount of threads used by parallel_for
+		int size() const {
+			return workers.size() + 1;
+		};
+
+		// Queue task for asynchronous execution
+		template<typename F>
+		auto submit(F&& f) -> std::future<decltype(f())> {
+			auto task = std::make_shared<std::packaged_task<decltype(f())()>>(std::forward<F>(f));
+			std::future<decltype(f())> result = task->get_future();
+
+			if (workers.empty()) {
+				(*task)();
+				return result;
+			}
+
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				tasks.emplace_back([task] { (*task)(); });
+			}
+
+			cv.notify_one();
+			return result;
+		};
+
+		// Call fn(i) for every i in [0, n) and wait for completion.
+		// Calling thread executes tasks too, so it is safe to call from the pool tasks.
+		void parallel_for(int n, const std::function<void(int)>& fn) {
+			if (n <= 0)
+				return;
+
+			if (n == 1 || workers.empty()) {
+				for (int i = 0; i < n; ++i)
+					fn(i);
+				return;
+			}
+
+			struct state {
+				std::atomic<int> next { 0 };
+				std::atomic<int> done { 0 };
+				std::mutex lock;
+				std::condition_variable cv;
+			};
+
+			auto st = std::make_shared<state>();
+			auto run = [st, n, &fn] {
+				int count = 0;
+				for (int i; (i = st->next.fetch_add(1)) < n; ++count)
+					fn(i);
+
+				if (count && st->done.fetch_add(count) + count == n) {
+					std::lock_guard<std::mutex> guard(st->lock);
+					st->cv.notify_all();
+				}
+			};
+
+			int helpers = std::min((int) workers.size(), n - 1);
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				for (int i = 0; i < helpers; ++i)
+					tasks.emplace_back(run);
+			}
+			cv.notify_all();
+
+			run();
+
+			std::unique_lock<std::mutex> guard(st->lock);
+			st->cv.wait(guard, [&] { return st->done.load() == n; });
+		};
+	};
+};
@@ -0,0 +1,285 @@
+/*
+ * (c) Copyright bitrate16 (GPLv3.0) 2020
+ */
+
+#pragma once
+
+#include <cstdlib>
+#include <cstddef>
+#include <new>
+#include <vector>
+#include <algorithm>
+
+#include "kernels/dense.h"
+
+namespace NNSpace {
+
+	// Alignment of the weight buffers in bytes (cache line / AVX-512 register)
+	const std::size_t WEIGHT_ALIGNMENT = 64;
+
+	// Allocator returning memory aligned to Align bytes.
+	// Used for the contiguous weight buffers.
+	template<typename T, std::size_t Align = WEIGHT_ALIGNMENT>
+	struct aligned_allocator {
+
+		typedef T value_type;
+
+		template<typename U>
+		struct rebind { typedef aligned_allocator<U, Align> other; };
+
+		aligned_allocator() {};
+
+		template<typename U>
+		aligned_allocator(const aligned_allocator<U, Align>&) {};
+
+		T* allocate(std::size_t n) {
+			if (n == 0)
+				return nullptr;
+
+			// aligned_alloc requires size to be multiple of alignment
+			std::size_t size = (n * sizeof(T) + Align - 1) / Align * Align;
+			void* p = std::aligned_alloc(Align, size);
+			if (!p)
+				throw std::bad_alloc();
+
+			return static_cast<T*>(p);
+		};
+
+		void deallocate(T* p, std::size_t) {
+			std::free(p);
+		};
+
+		template<typename U>
+		bool operator==(const aligned_allocator<U, Align>&) const { return 1; };
+
+		template<typename U>
+		bool operator!=(const aligned_allocator<U, Align>&) const { return 0; };
+	};
+
+	// Order of the weights in layer buffer
+	enum WeightLayout {
+		// W[i][j] at i * cols + j, rows of the input neurons are contiguous
+		ROW_MAJOR,
+		// W[i][j] at j * rows + i, transposed, weights of each output neuron are contiguous
+		COLUMN_MAJOR
+	};
+
+	// Weight matrix of a single layer stored in one aligned contiguous buffer.
+	// rows - size of input layer (i)
+	// cols - size of output layer (j)
+	// W[i][j] - weight of connection from input neuron i to output neuron j
+	class WeightMatrix {
+
+	public:
+
+		// Proxy for W[i][j] indexing of a single input neuron row
+		template<typename T>
+		struct RowProxy {
+			T* data;
+			int stride;
+
+			inline T& operator[](int j) const { return data[j * stride]; };
+		};
+
+		typedef std::vector<double, aligned_allocator<double>> buffer_type;
+
+		// Weights
+		buffer_type data;
+		// Amount of input neurons
+		int rows = 0;
+		// Amount of output neurons
+		int cols = 0;
+		// Order of weights in data
+		WeightLayout layout = ROW_MAJOR;
+
+		WeightMatrix() {};
+
+		WeightMatrix(int rows, int cols, WeightLayout layout = ROW_MAJOR) {
+			resize(rows, cols, layout);
+		};
+
+		// Resize and zero-fill the matrix
+		void resize(int r, int c, WeightLayout l) {
+			rows   = r;
+			cols   = c;
+			layout = l;
+			data.assign((std::size_t) r * c, 0.0);
+		};
+
+		void resize(int r, int c) {
+			resize(r, c, layout);
+		};
+
+		// Index of W[i][j] in data
+		inline std::size_t index(int i, int j) const {
+			return layout == ROW_MAJOR ? (std::size_t) i * cols + j : (std::size_t) j * rows + i;
+		};
+
+		inline double& at(int i, int j) { return data[index(i, j)]; };
+
+		inline const double& at(int i, int j) const { return data[index(i, j)]; };
+
+		inline RowProxy<double> operator[](int i) {
+			return layout == ROW_MAJOR ? RowProxy<double> { data.data() + (std::size_t) i * cols, 1 } : RowProxy<double> { data.data() + i, rows };
+		};
+
+		inline RowProxy<const double> operator[](int i) const {
+			return layout == ROW_MAJOR ? RowProxy<const double> { data.data() + (std::size_t) i * cols, 1 } : RowProxy<const double> { data.data() + i, rows };
+		};
+
+		inline double* raw() { return data.data(); };
+
+		inline const double* raw() const { return data.data(); };
+
+		inline std::size_t size() const { return data.size(); };
+
+		// Amount of non-zero weights
+		std::size_t nonzeros() const {
+			return data.size() - std::count(data.begin(), data.end(), 0.0);
+		};
+
+		// Convert matrix to the given layout
+		void set_layout(WeightLayout l) {
+			if (l == layout)
+				return;
+
+			buffer_type t(data.size());
+
+			for (int i = 0; i < rows; ++i)
+				for (int j = 0; j < cols; ++j)
+					if (l == ROW_MAJOR)
+						t[(std::size_t) i * cols + j] = data[(std::size_t) j * rows + i];
+					else
+						t[(std::size_t) j * rows + i] = data[(std::size_t) i * cols + j];
+
+			data.swap(t);
+			layout = l;
+		};
+
+		// Forward pass, out[j] += SUM [in[i] * W[i][j]]
+		void multiply(const double* in, double* out) const {
+			if (layout == ROW_MAJOR)
+				kernels::gemv_n(data.data(), rows, cols, in, out);
+			else
+				kernels::gemv_t(data.data(), cols, rows, in, out);
+		};
+
+		// Forward pass for batch of inputs, in is batch rows of size rows, out is batch rows of size cols
+		// out[b][j] += SUM [in[b][i] * W[i][j]]
+		void multiply_batch(const double* in, int batch, double* out) const {
+			if (layout == ROW_MAJOR)
+				kernels::gemm_nn(in, data.data(), out, batch, rows, cols);
+			else
+				kernels::gemm_nt(in, data.data(), out, batch, rows, cols);
+		};
+
+		// Backward pass, out[i] += SUM [W[i][j] * in[j]]
+		void multiply_transposed(const double* in, double* out) const {
+			if (layout == ROW_MAJOR)
+				kernels::gemv_t(data.data(), rows, cols, in, out);
+			else
+				kernels::gemv_n(data.data(), cols, rows, in, out);
+		};
+
+		// Backward pass for batch, in is batch rows of size cols, out is batch rows of size rows
+		// out[b][i] += SUM [W[i][j] * in[b][j]]
+		void multiply_transposed_batch(const double* in, int batch, double* out) const {
+			if (layout == ROW_MAJOR)
+				kernels::gemm_nt(in, data.data(), out, batch, cols, rows);
+			else
+				kernels::gemm_nn(in, data.data(), out, batch, cols, rows);
+		};
+
+		// Weights correction, W[i][j] += scale * a[i] * b[j]
+		void add_outer(double scale, const double* a, const double* b) {
+			if (layout == ROW_MAJOR) {
+				for (int i = 0; i < rows; ++i)
+					kernels::axpy(scale * a[i], b, data.data() + (std::size_t) i * cols, cols);
+			} else {
+				for (int j = 0; j < cols; ++j)
+					kernels::axpy(scale * b[j], a, data.data() + (std::size_t) j * rows, rows);
+			}
+		};
+
+		// Batched weights correction, a is batch rows of size rows, b is batch rows of size cols
+		// W[i][j] += scale * SUM [a[b][i] * b[b][j]]
+		void add_outer_batch(double scale, const double* a, const double* b, int batch) {
+			if (layout == ROW_MAJOR)
+				kernels::gemm_tn(scale, a, b, data.data(), rows, batch, cols);
+			else
+				kernels::gemm_tn(scale, b, a, data.data(), cols, batch, rows);
+		};
+
+		// Remove input neuron i
+		void remove_row(int i) {
+			remove(i, -1);
+		};
+
+		// Remove output neuron j
+		void remove_col(int j) {
+			remove(-1, j);
+		};
+
+		// Insert input neuron at i with weights w[0..cols-1]
+		void insert_row(int i, const double* w) {
+			insert(i, -1, w);
+		};
+
+		// Insert output neuron at j with weights w[0..rows-1]
+		void insert_col(int j, const double* w) {
+			insert(-1, j, w);
+		};
+
+	private:
+
+		// Copy matrix without row ri / column cj (-1 for none)
+		void remove(int ri, int cj) {
+			int nrows = rows - (ri >= 0);
+			int ncols = cols - (cj >= 0);
+			buffer_type t((std::size_t) nrows * ncols);
+
+			for (int i = 0, ni = 0; i < rows; ++i) {
+				if (i == ri)
+					continue;
+
+				for (int j = 0, nj = 0; j < cols; ++j) {
+					if (j == cj)
+						continue;
+
+					t[layout == ROW_MAJOR ? (std::size_t) ni * ncols + nj : (std::size_t) nj * nrows + ni] = at(i, j);
+					++nj;
+				}
+				++ni;
+			}
+
+			data.swap(t);
+			rows = nrows;
+			cols = ncols;
+		};
+
+		// Copy matrix with inserted row ri / column cj (-1 for none)
+		void insert(int ri, int cj, const double* w) {
+			int nrows = rows + (ri >= 0);
+			int ncols = cols + (cj >= 0);
+			buffer_type t((std::size_t) nrows * ncols);
+
+			for (int ni = 0; ni < nrows; ++ni)
+				for (int nj = 0; nj < ncols; ++nj) {
+					double v;
+
+					if (ni == ri)
+						v = w[nj];
+					else if (nj == cj)
+						v = w[ni - (ri >= 0 && ni > ri)];
+					else
+						v = at(ni - (ri >= 0 && ni > ri), nj - (cj >= 0 && nj > cj));
+
+					t[layout == ROW_MAJOR ? (std::size_t) ni * ncols + nj : (std::size_t) nj * nrows + ni] = v;
+				}
+
+			data.swap(t);
+			rows = nrows;
+			cols = ncols;
+		};
+	};
+};
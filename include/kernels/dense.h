@@ -0,0 +1,605 @@
+/*
+ * (c) Copyright bitrate16 (GPLv3.0) 2020
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <algorithm>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+	#define NN_KERNELS_X86
+	#include <immintrin.h>
+#endif
+
+// Dense vector / matrix kernels used by the layer evaluation.
+// Each kernel has portable version and x86 SSE2, AVX2 + FMA and AVX-512 versions,
+//  the best one supported by the CPU is selected on first use.
+namespace NNSpace {
+	namespace kernels {
+
+		enum ISA {
+			ISA_SCALAR,
+			ISA_SSE2,
+			ISA_AVX2,
+			ISA_AVX512
+		};
+
+
+		// P O R T A B L E
+
+
+		namespace scalar {
+
+			// Returns SUM [a[i] * b[i]]
+			inline double dot(const double* a, const double* b, int n) {
+				double s = 0.0;
+				for (int i = 0; i < n; ++i)
+					s += a[i] * b[i];
+				return s;
+			};
+
+			// y[i] += alpha * x[i]
+			inline void axpy(double alpha, const double* x, double* y, int n) {
+				for (int i = 0; i < n; ++i)
+					y[i] += alpha * x[i];
+			};
+
+			// Transposed matrix-vector product, W is m rows of n contiguous values
+			// y[j] += SUM [W[j * n + i] * x[i]]
+			inline void gemv_t(const double* W, int m, int n, const double* x, double* y) {
+				for (int j = 0; j < m; ++j)
+					y[j] += dot(W + (std::size_t) j * n, x, n);
+			};
+
+			// Matrix-vector product, W is n rows of m contiguous values
+			// y[j] += SUM [x[i] * W[i * m + j]]
+			inline void gemv_n(const double* W, int n, int m, const double* x, double* y) {
+				for (int i = 0; i < n; ++i)
+					axpy(x[i], W + (std::size_t) i * m, y, m);
+			};
+
+			// Matrix-matrix product block, A is M rows with stride lda, B is K rows of N contiguous values
+			// C[r * N + j] += SUM [A[r * lda + k] * B[k * N + j]]
+			inline void gemm_nn_block(const double* A, int lda, const double* B, double* C, int M, int K, int N) {
+				for (int r = 0; r < M; ++r)
+					gemv_n(B, K, N, A + (std::size_t) r * lda, C + (std::size_t) r * N);
+			};
+		};
+
+
+#ifdef NN_KERNELS_X86
+
+		// S S E 2
+
+
+		namespace sse2 {
+
+			__attribute__((target("sse2")))
+			inline double hsum(__m128d v) {
+				return _mm_cvtsd_f64(_mm_add_sd(v, _mm_unpackhi_pd(v, v)));
+			};
+
+			__attribute__((target("sse2")))
+			inline double dot(const double* a, const double* b, int n) {
+				__m128d s0 = _mm_setzero_pd();
+				__m128d s1 = _mm_setzero_pd();
+
+				int i = 0;
+				for (; i + 4 <= n; i += 4) {
+					s0 = _mm_add_pd(s0, _mm_mul_pd(_mm_loadu_pd(a + i),     _mm_loadu_pd(b + i)));
+					s1 = _mm_add_pd(s1, _mm_mul_pd(_mm_loadu_pd(a + i + 2), _mm_loadu_pd(b + i + 2)));
+				}
+
+				double s = hsum(_mm_add_pd(s0, s1));
+				for (; i < n; ++i)
+					s += a[i] * b[i];
+				return s;
+			};
+
+			__attribute__((target("sse2")))
+			inline void axpy(double alpha, const double* x, double* y, int n) {
+				__m128d va = _mm_set1_pd(alpha);
+
+				int i = 0;
+				for (; i + 2 <= n; i += 2)
+					_mm_storeu_pd(y + i, _mm_add_pd(_mm_loadu_pd(y + i), _mm_mul_pd(va, _mm_loadu_pd(x + i))));
+
+				for (; i < n; ++i)
+					y[i] += alpha * x[i];
+			};
+
+			__attribute__((target("sse2")))
+			inline void gemv_t(const double* W, int m, int n, const double* x, double* y) {
+				for (int j = 0; j < m; ++j)
+					y[j] += dot(W + (std::size_t) j * n, x, n);
+			};
+
+			__attribute__((target("sse2")))
+			inline void gemv_n(const double* W, int n, int m, const double* x, double* y) {
+				for (int i = 0; i < n; ++i)
+					axpy(x[i], W + (std::size_t) i * m, y, m);
+			};
+
+			__attribute__((target("sse2")))
+			inline void gemm_nn_block(const double* A, int lda, const double* B, double* C, int M, int K, int N) {
+				for (int r = 0; r < M; ++r)
+					gemv_n(B, K, N, A + (std::size_t) r * lda, C + (std::size_t) r * N);
+			};
+		};
+
+
+		// A V X 2
+
+
+		namespace avx2 {
+
+			__attribute__((target("avx2,fma")))
+			inline double hsum(__m256d v) {
+				__m128d lo = _mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+				return _mm_cvtsd_f64(_mm_add_sd(lo, _mm_unpackhi_pd(lo, lo)));
+			};
+
+			__attribute__((target("avx2,fma")))
+			inline double dot(const double* a, const double* b, int n) {
+				__m256d s0 = _mm256_setzero_pd();
+				__m256d s1 = _mm256_setzero_pd();
+
+				int i = 0;
+				for (; i + 8 <= n; i += 8) {
+					s0 = _mm256_fmadd_pd(_mm256_loadu_pd(a + i),     _mm256_loadu_pd(b + i),     s0);
+					s1 = _mm256_fmadd_pd(_mm256_loadu_pd(a + i + 4), _mm256_loadu_pd(b + i + 4), s1);
+				}
+				for (; i + 4 <= n; i += 4)
+					s0 = _mm256_fmadd_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i), s0);
+
+				double s = hsum(_mm256_add_pd(s0, s1));
+				for (; i < n; ++i)
+					s += a[i] * b[i];
+				return s;
+			};
+
+			__attribute__((target("avx2,fma")))
+			inline void axpy(double alpha, const double* x, double* y, int n) {
+				__m256d va = _mm256_set1_pd(alpha);
+
+				int i = 0;
+				for (; i + 4 <= n; i += 4)
+					_mm256_storeu_pd(y + i, _mm256_fmadd_pd(va, _mm256_loadu_pd(x + i), _mm256_loadu_pd(y + i)));
+
+				for (; i < n; ++i)
+					y[i] += alpha * x[i];
+			};
+
+			// Four output neurons at once, x is loaded once for all of them
+			__attribute__((target("avx2,fma")))
+			inline void gemv_t(const double* W, int m, int n, const double* x, double* y) {
+				int j = 0;
+				for (; j + 4 <= m; j += 4) {
+					const double* w0 = W + (std::size_t) (j + 0) * n;
+					const double* w1 = W + (std::size_t) (j + 1) * n;
+					const double* w2 = W + (std::size_t) (j + 2) * n;
+					const double* w3 = W + (std::size_t) (j + 3) * n;
+
+					__m256d s0 = _mm256_setzero_pd();
+					__m256d s1 = _mm256_setzero_pd();
+					__m256d s2 = _mm256_setzero_pd();
+					__m256d s3 = _mm256_setzero_pd();
+
+					int i = 0;
+					for (; i + 4 <= n; i += 4) {
+						__m256d vx = _mm256_loadu_pd(x + i);
+						s0 = _mm256_fmadd_pd(_mm256_loadu_pd(w0 + i), vx, s0);
+						s1 = _mm256_fmadd_pd(_mm256_loadu_pd(w1 + i), vx, s1);
+						s2 = _mm256_fmadd_pd(_mm256_loadu_pd(w2 + i), vx, s2);
+						s3 = _mm256_fmadd_pd(_mm256_loadu_pd(w3 + i), vx, s3);
+					}
+
+					// Reduce four accumulators into one vector of four sums
+					__m256d t0 = _mm256_hadd_pd(s0, s1);
+					__m256d t1 = _mm256_hadd_pd(s2, s3);
+					__m256d r  = _mm256_add_pd(_mm256_permute2f128_pd(t0, t1, 0x20), _mm256_permute2f128_pd(t0, t1, 0x31));
+
+					double t[4];
+					_mm256_storeu_pd(t, r);
+					for (; i < n; ++i) {
+						t[0] += w0[i] * x[i];
+						t[1] += w1[i] * x[i];
+						t[2] += w2[i] * x[i];
+						t[3] += w3[i] * x[i];
+					}
+
+					y[j + 0] += t[0];
+					y[j + 1] += t[1];
+					y[j + 2] += t[2];
+					y[j + 3] += t[3];
+				}
+
+				for (; j < m; ++j)
+					y[j] += dot(W + (std::size_t) j * n, x, n);
+			};
+
+			// Four input neurons at once, y is loaded and stored once for all of them
+			__attribute__((target("avx2,fma")))
+			inline void gemv_n(const double* W, int n, int m, const double* x, double* y) {
+				int i = 0;
+				for (; i + 4 <= n; i += 4) {
+					const double* w0 = W + (std::size_t) (i + 0) * m;
+					const double* w1 = W + (std::size_t) (i + 1) * m;
+					const double* w2 = W + (std::size_t) (i + 2) * m;
+					const double* w3 = W + (std::size_t) (i + 3) * m;
+
+					__m256d x0 = _mm256_set1_pd(x[i + 0]);
+					__m256d x1 = _mm256_set1_pd(x[i + 1]);
+					__m256d x2 = _mm256_set1_pd(x[i + 2]);
+					__m256d x3 = _mm256_set1_pd(x[i + 3]);
+
+					int j = 0;
+					for (; j + 4 <= m; j += 4) {
+						__m256d vy = _mm256_loadu_pd(y + j);
+						vy = _mm256_fmadd_pd(x0, _mm256_loadu_pd(w0 + j), vy);
+						vy = _mm256_fmadd_pd(x1, _mm256_loadu_pd(w1 + j), vy);
+						vy = _mm256_fmadd_pd(x2, _mm256_loadu_pd(w2 + j), vy);
+						vy = _mm256_fmadd_pd(x3, _mm256_loadu_pd(w3 + j), vy);
+						_mm256_storeu_pd(y + j, vy);
+					}
+
+					for (; j < m; ++j)
+						y[j] += x[i + 0] * w0[j] + x[i + 1] * w1[j] + x[i + 2] * w2[j] + x[i + 3] * w3[j];
+				}
+
+				for (; i < n; ++i)
+					axpy(x[i], W + (std::size_t) i * m, y, m);
+			};
+
+			// Four rows of A by eight columns of B, C block is kept in registers over K
+			__attribute__((target("avx2,fma")))
+			inline void gemm_nn_block(const double* A, int lda, const double* B, double* C, int M, int K, int N) {
+				int r = 0;
+				for (; r + 4 <= M; r += 4) {
+					const double* a0 = A + (std::size_t) (r + 0) * lda;
+					const double* a1 = A + (std::size_t) (r + 1) * lda;
+					const double* a2 = A + (std::size_t) (r + 2) * lda;
+					const double* a3 = A + (std::size_t) (r + 3) * lda;
+					double* c0 = C + (std::size_t) (r + 0) * N;
+					double* c1 = C + (std::size_t) (r + 1) * N;
+					double* c2 = C + (std::size_t) (r + 2) * N;
+					double* c3 = C + (std::size_t) (r + 3) * N;
+
+					int j = 0;
+					for (; j + 8 <= N; j += 8) {
+						__m256d c00 = _mm256_loadu_pd(c0 + j), c01 = _mm256_loadu_pd(c0 + j + 4);
+						__m256d c10 = _mm256_loadu_pd(c1 + j), c11 = _mm256_loadu_pd(c1 + j + 4);
+						__m256d c20 = _mm256_loadu_pd(c2 + j), c21 = _mm256_loadu_pd(c2 + j + 4);
+						__m256d c30 = _mm256_loadu_pd(c3 + j), c31 = _mm256_loadu_pd(c3 + j + 4);
+
+						for (int k = 0; k < K; ++k) {
+							const double* b = B + (std::size_t) k * N + j;
+							__m256d b0 = _mm256_loadu_pd(b);
+							__m256d b1 = _mm256_loadu_pd(b + 4);
+							__m256d va;
+
+							va = _mm256_broadcast_sd(a0 + k); c00 = _mm256_fmadd_pd(va, b0, c00); c01 = _mm256_fmadd_pd(va, b1, c01);
+							va = _mm256_broadcast_sd(a1 + k); c10 = _mm256_fmadd_pd(va, b0, c10); c11 = _mm256_fmadd_pd(va, b1, c11);
+							va = _mm256_broadcast_sd(a2 + k); c20 = _mm256_fmadd_pd(va, b0, c20); c21 = _mm256_fmadd_pd(va, b1, c21);
+							va = _mm256_broadcast_sd(a3 + k); c30 = _mm256_fmadd_pd(va, b0, c30); c31 = _mm256_fmadd_pd(va, b1, c31);
+						}
+
+						_mm256_storeu_pd(c0 + j, c00); _mm256_storeu_pd(c0 + j + 4, c01);
+						_mm256_storeu_pd(c1 + j, c10); _mm256_storeu_pd(c1 + j + 4, c11);
+						_mm256_storeu_pd(c2 + j, c20); _mm256_storeu_pd(c2 + j + 4, c21);
+						_mm256_storeu_pd(c3 + j, c30); _mm256_storeu_pd(c3 + j + 4, c31);
+					}
+
+					// Remaining columns
+					for (; j < N; ++j) {
+						double s0 = 0.0, s1 = 0.0, s2 = 0.0, s3 = 0.0;
+						for (int k = 0; k < K; ++k) {
+							double b = B[(std::size_t) k * N + j];
+							s0 += a0[k] * b;
+							s1 += a1[k] * b;
+							s2 += a2[k] * b;
+							s3 += a3[k] * b;
+						}
+						c0[j] += s0;
+						c1[j] += s1;
+						c2[j] += s2;
+						c3[j] += s3;
+					}
+				}
+
+				for (; r < M; ++r)
+					gemv_n(B, K, N, A + (std::size_t) r * lda, C + (std::size_t) r * N);
+			};
+		};
+
+
+		// A V X - 5 1 2
+
+
+		namespace avx512 {
+
+			__attribute__((target("avx512f")))
+			inline double hsum(__m512d v) {
+				// Zero-masked extracts, plain ones expand to undefined source GCC 12 warns about
+				__m256d h = _mm256_add_pd(_mm512_maskz_extractf64x4_pd((__mmask8) 0xFF, v, 0), _mm512_maskz_extractf64x4_pd((__mmask8) 0xFF, v, 1));
+				__m128d lo = _mm_add_pd(_mm256_castpd256_pd128(h), _mm256_extractf128_pd(h, 1));
+				return _mm_cvtsd_f64(_mm_add_sd(lo, _mm_unpackhi_pd(lo, lo)));
+			};
+
+			__attribute__((target("avx512f")))
+			inline double dot(const double* a, const double* b, int n) {
+				__m512d s0 = _mm512_setzero_pd();
+				__m512d s1 = _mm512_setzero_pd();
+
+				int i = 0;
+				for (; i + 16 <= n; i += 16) {
+					s0 = _mm512_fmadd_pd(_mm512_loadu_pd(a + i),     _mm512_loadu_pd(b + i),     s0);
+					s1 = _mm512_fmadd_pd(_mm512_loadu_pd(a + i + 8), _mm512_loadu_pd(b + i + 8), s1);
+				}
+				for (; i + 8 <= n; i += 8)
+					s0 = _mm512_fmadd_pd(_mm512_loadu_pd(a + i), _mm512_loadu_pd(b + i), s0);
+
+				if (i < n) {
+					__mmask8 mask = (__mmask8) ((1u << (n - i)) - 1);
+					s1 = _mm512_fmadd_pd(_mm512_maskz_loadu_pd(mask, a + i), _mm512_maskz_loadu_pd(mask, b + i), s1);
+				}
+
+				return hsum(_mm512_add_pd(s0, s1));
+			};
+
+			__attribute__((target("avx512f")))
+			inline void axpy(double alpha, const double* x, double* y, int n) {
+				__m512d va = _mm512_set1_pd(alpha);
+
+				int i = 0;
+				for (; i + 8 <= n; i += 8)
+					_mm512_storeu_pd(y + i, _mm512_fmadd_pd(va, _mm512_loadu_pd(x + i), _mm512_loadu_pd(y + i)));
+
+				if (i < n) {
+					__mmask8 mask = (__mmask8) ((1u << (n - i)) - 1);
+					_mm512_mask_storeu_pd(y + i, mask, _mm512_fmadd_pd(va, _mm512_maskz_loadu_pd(mask, x + i), _mm512_maskz_loadu_pd(mask, y + i)));
+				}
+			};
+
+			// Four output neurons at once, x is loaded once for all of them
+			__attribute__((target("avx512f")))
+			inline void gemv_t(const double* W, int m, int n, const double* x, double* y) {
+				int j = 0;
+				for (; j + 4 <= m; j += 4) {
+					const double* w0 = W + (std::size_t) (j + 0) * n;
+					const double* w1 = W + (std::size_t) (j + 1) * n;
+					const double* w2 = W + (std::size_t) (j + 2) * n;
+					const double* w3 = W + (std::size_t) (j + 3) * n;
+
+					__m512d s0 = _mm512_setzero_pd();
+					__m512d s1 = _mm512_setzero_pd();
+					__m512d s2 = _mm512_setzero_pd();
+					__m512d s3 = _mm512_setzero_pd();
+
+					int i = 0;
+					for (; i + 8 <= n; i += 8) {
+						__m512d vx = _mm512_loadu_pd(x + i);
+						s0 = _mm512_fmadd_pd(_mm512_loadu_pd(w0 + i), vx, s0);
+						s1 = _mm512_fmadd_pd(_mm512_loadu_pd(w1 + i), vx, s1);
+						s2 = _mm512_fmadd_pd(_mm512_loadu_pd(w2 + i), vx, s2);
+						s3 = _mm512_fmadd_pd(_mm512_loadu_pd(w3 + i), vx, s3);
+					}
+
+					if (i < n) {
+						__mmask8 mask = (__mmask8) ((1u << (n - i)) - 1);
+						__m512d vx = _mm512_maskz_loadu_pd(mask, x + i);
+						s0 = _mm512_fmadd_pd(_mm512_maskz_loadu_pd(mask, w0 + i), vx, s0);
+						s1 = _mm512_fmadd_pd(_mm512_maskz_loadu_pd(mask, w1 + i), vx, s1);
+						s2 = _mm512_fmadd_pd(_mm512_maskz_loadu_pd(mask, w2 + i), vx, s2);
+						s3 = _mm512_fmadd_pd(_mm512_maskz_loadu_pd(mask, w3 + i), vx, s3);
+					}
+
+					y[j + 0] += hsum(s0);
+					y[j + 1] += hsum(s1);
+					y[j + 2] += hsum(s2);
+					y[j + 3] += hsum(s3);
+				}
+
+				for (; j < m; ++j)
+					y[j] += dot(W + (std::size_t) j * n, x, n);
+			};
+
+			// Four input neurons at once, y is loaded and stored once for all of them
+			__attribute__((target("avx512f")))
+			inline void gemv_n(const double* W, int n, int m, const double* x, double* y) {
+				int i = 0;
+				for (; i + 4 <= n; i += 4) {
+					const double* w0 = W + (std::size_t) (i + 0) * m;
+					const double* w1 = W + (std::size_t) (i + 1) * m;
+					const double* w2 = W + (std::size_t) (i + 2) * m;
+					const double* w3 = W + (std::size_t) (i + 3) * m;
+
+					__m512d x0 = _mm512_set1_pd(x[i + 0]);
+					__m512d x1 = _mm512_set1_pd(x[i + 1]);
+					__m512d x2 = _mm512_set1_pd(x[i + 2]);
+					__m512d x3 = _mm512_set1_pd(x[i + 3]);
+
+					int j = 0;
+					for (; j + 8 <= m; j += 8) {
+						__m512d vy = _mm512_loadu_pd(y + j);
+						vy = _mm512_fmadd_pd(x0, _mm512_loadu_pd(w0 + j), vy);
+						vy = _mm512_fmadd_pd(x1, _mm512_loadu_pd(w1 + j), vy);
+						vy = _mm512_fmadd_pd(x2, _mm512_loadu_pd(w2 + j), vy);
+						vy = _mm512_fmadd_pd(x3, _mm512_loadu_pd(w3 + j), vy);
+						_mm512_storeu_pd(y + j, vy);
+					}
+
+					if (j < m) {
+						__mmask8 mask = (__mmask8) ((1u << (m - j)) - 1);
+						__m512d vy = _mm512_maskz_loadu_pd(mask, y + j);
+						vy = _mm512_fmadd_pd(x0, _mm512_maskz_loadu_pd(mask, w0 + j), vy);
+						vy = _mm512_fmadd_pd(x1, _mm512_maskz_loadu_pd(mask, w1 + j), vy);
+						vy = _mm512_fmadd_pd(x2, _mm512_maskz_loadu_pd(mask, w2 + j), vy);
+						vy = _mm512_fmadd_pd(x3, _mm512_maskz_loadu_pd(mask, w3 + j), vy);
+						_mm512_mask_storeu_pd(y + j, mask, vy);
+					}
+				}
+
+				for (; i < n; ++i)
+					axpy(x[i], W + (std::size_t) i * m, y, m);
+			};
+
+			// Four rows of A by sixteen columns of B, C block is kept in registers over K
+			__attribute__((target("avx512f")))
+			inline void gemm_nn_block(const double* A, int lda, const double* B, double* C, int M, int K, int N) {
+				int r = 0;
+				for (; r + 4 <= M; r += 4) {
+					const double* a0 = A + (std::size_t) (r + 0) * lda;
+					const double* a1 = A + (std::size_t) (r + 1) * lda;
+					const double* a2 = A + (std::size_t) (r + 2) * lda;
+					const double* a3 = A + (std::size_t) (r + 3) * lda;
+					double* c0 = C + (std::size_t) (r + 0) * N;
+					double* c1 = C + (std::size_t) (r + 1) * N;
+					double* c2 = C + (std::size_t) (r + 2) * N;
+					double* c3 = C + (std::size_t) (r + 3) * N;
+
+					for (int j = 0; j < N; j += 16) {
+						// Masks for the last incomplete columns
+						int rest = N - j;
+						__mmask8 m0 = rest >= 8  ? (__mmask8) 0xFF : (__mmask8) ((1u << rest) - 1);
+						__mmask8 m1 = rest >= 16 ? (__mmask8) 0xFF : rest > 8 ? (__mmask8) ((1u << (rest - 8)) - 1) : (__mmask8) 0;
+
+						__m512d c00 = _mm512_maskz_loadu_pd(m0, c0 + j), c01 = _mm512_maskz_loadu_pd(m1, c0 + j + 8);
+						__m512d c10 = _mm512_maskz_loadu_pd(m0, c1 + j), c11 = _mm512_maskz_loadu_pd(m1, c1 + j + 8);
+						__m512d c20 = _mm512_maskz_loadu_pd(m0, c2 + j), c21 = _mm512_maskz_loadu_pd(m1, c2 + j + 8);
+						__m512d c30 = _mm512_maskz_loadu_pd(m0, c3 + j), c31 = _mm512_maskz_loadu_pd(m1, c3 + j + 8);
+
+						for (int k = 0; k < K; ++k) {
+							const double* b = B + (std::size_t) k * N + j;
+							__m512d b0 = _mm512_maskz_loadu_pd(m0, b);
+							__m512d b1 = _mm512_maskz_loadu_pd(m1, b + 8);
+							__m512d va;
+
+							va = _mm512_set1_pd(a0[k]); c00 = _mm512_fmadd_pd(va, b0, c00); c01 = _mm512_fmadd_pd(va, b1, c01);
+							va = _mm512_set1_pd(a1[k]); c10 = _mm512_fmadd_pd(va, b0, c10); c11 = _mm512_fmadd_pd(va, b1, c11);
+							va = _mm512_set1_pd(a2[k]); c20 = _mm512_fmadd_pd(va, b0, c20); c21 = _mm512_fmadd_pd(va, b1, c21);
+							va = _mm512_set1_pd(a3[k]); c30 = _mm512_fmadd_pd(va, b0, c30); c31 = _mm512_fmadd_pd(va, b1, c31);
+						}
+
+						_mm512_mask_storeu_pd(c0 + j, m0, c00); _mm512_mask_storeu_pd(c0 + j + 8, m1, c01);
+						_mm512_mask_storeu_pd(c1 + j, m0, c10); _mm512_mask_storeu_pd(c1 + j + 8, m1, c11);
+						_mm512_mask_storeu_pd(c2 + j, m0, c20); _mm512_mask_storeu_pd(c2 + j + 8, m1, c21);
+						_mm512_mask_storeu_pd(c3 + j, m0, c30); _mm512_mask_storeu_pd(c3 + j + 8, m1, c31);
+					}
+				}
+
+				for (; r < M; ++r)
+					gemv_n(B, K, N, A + (std::size_t) r * lda, C + (std::size_t) r * N);
+			};
+		};
+
+#endif
+
+
+		// D I S P A T C H
+
+
+		// Set of kernels for the selected instruction set
+		struct dense_table {
+			ISA isa;
+			double (*dot)(const double* a, const double* b, int n);
+			void (*axpy)(double alpha, const double* x, double* y, int n);
+			void (*gemv_t)(const double* W, int m, int n, const double* x, double* y);
+			void (*gemv_n)(const double* W, int n, int m, const double* x, double* y);
+			void (*gemm_nn_block)(const double* A, int lda, const double* B, double* C, int M, int K, int N);
+		};
+
+		// Returns best instruction set supported by the CPU
+		inline ISA detect_isa() {
+#ifdef NN_KERNELS_X86
+			__builtin_cpu_init();
+
+			if (__builtin_cpu_supports("avx512f"))
+				return ISA_AVX512;
+			if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+				return ISA_AVX2;
+			if (__builtin_cpu_supports("sse2"))
+				return ISA_SSE2;
+#endif
+			return ISA_SCALAR;
+		};
+
+		inline dense_table make_table(ISA isa) {
+#ifdef NN_KERNELS_X86
+			switch (isa) {
+				case ISA_AVX512: return { ISA_AVX512, avx512::dot, avx512::axpy, avx512::gemv_t, avx512::gemv_n, avx512::gemm_nn_block };
+				case ISA_AVX2:   return { ISA_AVX2,   avx2::dot,   avx2::axpy,   avx2::gemv_t,   avx2::gemv_n,   avx2::gemm_nn_block   };
+				case ISA_SSE2:   return { ISA_SSE2,   sse2::dot,   sse2::axpy,   sse2::gemv_t,   sse2::gemv_n,   sse2::gemm_nn_block   };
+				default: break;
+			}
+#endif
+			return { ISA_SCALAR, scalar::dot, scalar::axpy, scalar::gemv_t, scalar::gemv_n, scalar::gemm_nn_block };
+		};
+
+		// Active kernels, selected once on first call
+		inline const dense_table& table() {
+			static dense_table t = make_table(detect_isa());
+			return t;
+		};
+
+		inline ISA current_isa() {
+			return table().isa;
+		};
+
+		inline double dot(const double* a, const double* b, int n) {
+			return table().dot(a, b, n);
+		};
+
+		inline void axpy(double alpha, const double* x, double* y, int n) {
+			table().axpy(alpha, x, y, n);
+		};
+
+		inline void gemv_t(const double* W, int m, int n, const double* x, double* y) {
+			table().gemv_t(W, m, n, x, y);
+		};
+
+		inline void gemv_n(const double* W, int n, int m, const double* x, double* y) {
+			table().gemv_n(W, n, m, x, y);
+		};
+
+		// Size of the block of B in doubles kept in cache while it is being multiplied (256 KB)
+		const int GEMM_BLOCK = 32768;
+
+		// Matrix-matrix product, A is M rows of K values, B is K rows of N values
+		// C[M][N] += A[M][K] * B[K][N]
+		// B is split into blocks of rows fitting in cache, each block is reused by all rows of A.
+		inline void gemm_nn(const double* A, const double* B, double* C, int M, int K, int N) {
+			int kb = std::max(8, GEMM_BLOCK / std::max(1, N));
+
+			for (int k = 0; k < K; k += kb)
+				table().gemm_nn_block(A + k, K, B + (std::size_t) k * N, C, M, std::min(kb, K - k), N);
+		};
+
+		// Matrix-matrix product with transposed B, A is M rows of K values, B is N rows of K values
+		// C[M][N] += A[M][K] * B[N][K]^T
+		// B is split into blocks of rows fitting in cache, each block is reused by all rows of A.
+		inline void gemm_nt(const double* A, const double* B, double* C, int M, int K, int N) {
+			int nb = std::max(4, GEMM_BLOCK / std::max(1, K));
+
+			for (int n = 0; n < N; n += nb)
+				for (int r = 0; r < M; ++r)
+					table().gemv_t(B + (std::size_t) n * K, std::min(nb, N - n), K, A + (std::size_t) r * K, C + (std::size_t) r * N + n);
+		};
+
+		// Scaled matrix-matrix product with transposed A, A is K rows of M values, B is K rows of N values
+		// C[M][N] += alpha * A[K][M]^T * B[K][N]
+		// C is split into blocks of rows fitting in cache, each block accumulates all rows of B.
+		inline void gemm_tn(double alpha, const double* A, const double* B, double* C, int M, int K, int N) {
+			int mb = std::max(4, GEMM_BLOCK / std::max(1, N));
+
+			for (int m = 0; m < M; m += mb)
+				for (int k = 0; k < K; ++k)
+					for (int i = m; i < std::min(M, m + mb); ++i) {
+						double a = A[(std::size_t) k * M + i];
+						if (a != 0.0)
+							table().axpy(alpha * a, B + (std::size_t) k * N, C + (std::size_t) i * N, N);
+					}
+		};
+	};
+};
@@ -0,0 +1,82 @@
+/*
+ * (c) Copyright bitrate16 (GPLv3.0) 2020
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// Sparse matrix kernels used by the layer evaluation.
+// Matrix is stored in CSR format by rows of input neurons:
+//  weights of row i are values[starts[i] .. starts[i + 1]) with output neuron indices in columns.
+// Cost of every kernel is proportional to the amount of stored weights,
+//  rows of zero input values are skipped.
+namespace NNSpace {
+	namespace kernels {
+
+		// Sparse matrix-vector product, W is n rows in CSR format
+		// y[j] += SUM [x[i] * W[i][j]]
+		inline void csr_gemv(const int* starts, const int* columns, const double* values, int n, const double* x, double* y) {
+			for (int i = 0; i < n; ++i) {
+				double a = x[i];
+				if (a == 0.0)
+					continue;
+
+				for (int p = starts[i]; p < starts[i + 1]; ++p)
+					y[columns[p]] += a * values[p];
+			}
+		};
+
+		// Amount of rows of A processed at once by csr_gemm()
+		const int CSR_BLOCK = 8;
+
+		// Sparse matrix-matrix product, A is M rows of K values, W is K rows in CSR format, C is M rows of N values
+		// C[M][N] += A[M][K] * W[K][N]
+		// CSR_BLOCK rows of A and C are interleaved into temporary blocks,
+		//  so every stored weight updates CSR_BLOCK contiguous values.
+		inline void csr_gemm(const double* A, const int* starts, const int* columns, const double* values, double* C, int M, int K, int N) {
+			const int R = CSR_BLOCK;
+			std::vector<double> a, c;
+
+			int r = 0;
+			if (M >= R) {
+				a.resize((std::size_t) K * R);
+				c.resize((std::size_t) N * R);
+			}
+
+			for (; r + R <= M; r += R) {
+				for (int q = 0; q < R; ++q) {
+					for (int i = 0; i < K; ++i)
+						a[(std::size_t) i * R + q] = A[(std::size_t) (r + q) * K + i];
+					for (int j = 0; j < N; ++j)
+						c[(std::size_t) j * R + q] = C[(std::size_t) (r + q) * N + j];
+				}
+
+				for (int i = 0; i < K; ++i) {
+					const double* x = a.data() + (std::size_t) i * R;
+
+					bool zero = 1;
+					for (int q = 0; q < R; ++q)
+						zero &= x[q] == 0.0;
+					if (zero)
+						continue;
+
+					for (int p = starts[i]; p < starts[i + 1]; ++p) {
+						double* y = c.data() + (std::size_t) columns[p] * R;
+						double v  = values[p];
+						for (int q = 0; q < R; ++q)
+							y[q] += x[q] * v;
+					}
+				}
+
+				for (int q = 0; q < R; ++q)
+					for (int j = 0; j < N; ++j)
+						C[(std::size_t) (r + q) * N + j] = c[(std::size_t) j * R + q];
+			}
+
+			for (; r < M; ++r)
+				csr_gemv(starts, columns, values, K, A + (std::size_t) r * K, C + (std::size_t) r * N);
+		};
+	};
+};
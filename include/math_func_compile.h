@@ -0,0 +1,378 @@
+#pragma once
+
+#include "math_func.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <cmath>
+
+namespace math_func {
+
+	// Function compiled into flat stack bytecode.
+	// Variables are read from slots by index, builtin functions are executed directly,
+	//  other functions are called from func_functions table.
+	struct program {
+		// push value
+		static const int CONST  = 0;
+		// push slots[arg]
+		static const int VAR    = 1;
+		// pop b, a, push a op b
+		static const int ADD    = 2;
+		static const int SUB    = 3;
+		static const int MUL    = 4;
+		static const int DIV    = 5;
+		static const int POW    = 6;
+		// pop a, push op(a)
+		static const int NEG    = 7;
+		static const int SIN    = 8;
+		static const int COS    = 9;
+		static const int TAN    = 10;
+		static const int CTAN   = 11;
+		static const int EXP    = 12;
+		static const int LOG    = 13;
+		static const int ARCSIN = 14;
+		static const int ARCCOS = 15;
+		static const int ARCTAN = 16;
+		static const int SQRT   = 17;
+		static const int ABS    = 18;
+		// pop argc values, push calls[arg](values)
+		static const int CALL   = 19;
+
+		struct instruction {
+			int opcode;
+			// Slot or call index
+			int arg;
+			// Amount of call arguments
+			int argc;
+			double value;
+		};
+
+		std::vector<instruction> code;
+		// Variable name of each slot
+		std::vector<std::string> variables;
+		// Non-builtin functions
+		std::vector<std::function<double(const std::vector<double>&)>> calls;
+		// Maximal depth of stack
+		int stack_size = 0;
+
+		// Amount of points evaluated by single instruction in columnar evaluation
+		static const int BLOCK_SIZE = 1024;
+		// Amount of points of single task in parallel columnar evaluation
+		static const int TASK_SIZE = 16 * BLOCK_SIZE;
+
+		// Slot of variable, -1 if not used
+		int slot(const std::string& name) const {
+			for (int i = 0; i < variables.size(); ++i)
+				if (variables[i] == name)
+					return i;
+			return -1;
+		};
+
+		// Evaluate with variable values in slots
+		double evaluate(const double* slots) const {
+			if (stack_size <= 64) {
+				double s[64];
+				return run(slots, s);
+			}
+
+			std::vector<double> s(stack_size);
+			return run(slots, s.data());
+		};
+
+		// Evaluate over n points, columns[k] - n values of variable k.
+		// Executed one instruction at a time over blocks of points, results are written into out.
+		void evaluate(const double* const* columns, std::size_t n, double* out) const {
+			std::vector<double> s((std::size_t) std::max(1, stack_size) * BLOCK_SIZE);
+
+			for (std::size_t i = 0; i < n; i += BLOCK_SIZE)
+				run(columns, i, (int) std::min<std::size_t>(BLOCK_SIZE, n - i), s.data(), out + i);
+		};
+
+		// Evaluate over n points, parts of TASK_SIZE points are evaluated in parallel on pool
+		void evaluate(const double* const* columns, std::size_t n, double* out, NNSpace::ThreadPool& pool) const {
+			if (n <= TASK_SIZE || pool.size() == 1) {
+				evaluate(columns, n, out);
+				return;
+			}
+
+			pool.parallel_for((int) ((n + TASK_SIZE - 1) / TASK_SIZE), [this, columns, n, out](int t) {
+				std::size_t from = (std::size_t) t * TASK_SIZE;
+				std::vector<const double*> part(columns, columns + variables.size());
+				for (const double*& c : part)
+					c += from;
+
+				evaluate(part.data(), std::min<std::size_t>(TASK_SIZE, n - from), out + from);
+			});
+		};
+
+	private:
+
+		// Execute code on stack s
+		double run(const double* slots, double* s) const {
+			double* top = s - 1;
+
+			for (const instruction* in = code.data(), * end = in + code.size(); in != end; ++in)
+				switch (in->opcode) {
+					case CONST:  *++top = in->value;                  break;
+					case VAR:    *++top = slots[in->arg];             break;
+					case ADD:    top[-1] = top[-1] + *top; --top;     break;
+					case SUB:    top[-1] = top[-1] - *top; --top;     break;
+					case MUL:    top[-1] = top[-1] * *top; --top;     break;
+					case DIV:    top[-1] = top[-1] / *top; --top;     break;
+					case POW:    top[-1] = std::pow(top[-1], *top); --top; break;
+					case NEG:    *top = -*top;                        break;
+					case SIN:    *top = std::sin(*top);               break;
+					case COS:    *top = std::cos(*top);               break;
+					case TAN:    *top = std::tan(*top);               break;
+					case CTAN:   *top = std::cos(*top) / std::sin(*top); break;
+					case EXP:    *top = std::exp(*top);               break;
+					case LOG:    *top = std::log(*top);               break;
+					case ARCSIN: *top = std::asin(*top);              break;
+					case ARCCOS: *top = std::acos(*top);              break;
+					case ARCTAN: *top = std::atan(*top);              break;
+					case SQRT:   *top = std::sqrt(*top);              break;
+					case ABS:    *top = std::fabs(*top);              break;
+					case CALL:
+						top -= in->argc - 1;
+						*top = call(in->arg, top, in->argc);
+						break;
+				}
+
+			return *s;
+		};
+
+		// Execute code over count points starting from point i on stack of blocks s
+		void run(const double* const* columns, std::size_t i, int count, double* s, double* out) const {
+			double* top = s - BLOCK_SIZE;
+
+			// top = op(top)
+			auto unary = [&top, count](auto op) {
+				for (int k = 0; k < count; ++k)
+					top[k] = op(top[k]);
+			};
+
+			// top - 1 = op(top - 1, top), pop
+			auto binary = [&top, count](auto op) {
+				double* a = top - BLOCK_SIZE;
+				for (int k = 0; k < count; ++k)
+					a[k] = op(a[k], top[k]);
+				top = a;
+			};
+
+			for (const instruction* in = code.data(), * end = in + code.size(); in != end; ++in)
+				switch (in->opcode) {
+					case CONST:
+						top += BLOCK_SIZE;
+						std::fill(top, top + count, in->value);
+						break;
+					case VAR:
+						top += BLOCK_SIZE;
+						std::copy(columns[in->arg] + i, columns[in->arg] + i + count, top);
+						break;
+					case ADD:    binary([](double a, double b) { return a + b; });           break;
+					case SUB:    binary([](double a, double b) { return a - b; });           break;
+					case MUL:    binary([](double a, double b) { return a * b; });           break;
+					case DIV:    binary([](double a, double b) { return a / b; });           break;
+					case POW:    binary([](double a, double b) { return std::pow(a, b); });  break;
+					case NEG:    unary([](double a) { return -a; });                         break;
+					case SIN:    unary([](double a) { return std::sin(a); });                break;
+					case COS:    unary([](double a) { return std::cos(a); });                break;
+					case TAN:    unary([](double a) { return std::tan(a); });                break;
+					case CTAN:   unary([](double a) { return std::cos(a) / std::sin(a); });  break;
+					case EXP:    unary([](double a) { return std::exp(a); });                break;
+					case LOG:    unary([](double a) { return std::log(a); });                break;
+					case ARCSIN: unary([](double a) { return std::asin(a); });               break;
+					case ARCCOS: unary([](double a) { return std::acos(a); });               break;
+					case ARCTAN: unary([](double a) { return std::atan(a); });               break;
+					case SQRT:   unary([](double a) { return std::sqrt(a); });               break;
+					case ABS:    unary([](double a) { return std::fabs(a); });               break;
+					case CALL: {
+						// Arguments are rows of argc blocks
+						top -= (std::size_t) (in->argc - 1) * BLOCK_SIZE;
+						std::vector<double> argv(in->argc);
+						for (int k = 0; k < count; ++k) {
+							for (int a = 0; a < in->argc; ++a)
+								argv[a] = top[(std::size_t) a * BLOCK_SIZE + k];
+							top[k] = calls[in->arg](argv);
+						}
+						break;
+					}
+				}
+
+			std::copy(s, s + count, out);
+		};
+
+		// Call of non-builtin function
+		double call(int index, const double* argv, int argc) const {
+			return calls[index](std::vector<double>(argv, argv + argc));
+		};
+	};
+
+	namespace compiler {
+
+		typedef double (*function)(const std::vector<double>&);
+
+		// Default implementations of builtins, missing argument is 0
+		inline double arg(const std::vector<double>& t) { return t.size() == 0 ? 0.0 : t[0]; };
+
+		inline double call_sin   (const std::vector<double>& t) { return std::sin(arg(t));  };
+		inline double call_cos   (const std::vector<double>& t) { return std::cos(arg(t));  };
+		inline double call_tan   (const std::vector<double>& t) { return std::tan(arg(t));  };
+		inline double call_ctan  (const std::vector<double>& t) { return std::cos(arg(t)) / std::sin(arg(t)); };
+		inline double call_exp   (const std::vector<double>& t) { return std::exp(arg(t));  };
+		inline double call_log   (const std::vector<double>& t) { return t.size() == 0 ? 0.0 : std::log(t[0]); };
+		inline double call_arcsin(const std::vector<double>& t) { return std::asin(arg(t)); };
+		inline double call_arccos(const std::vector<double>& t) { return std::acos(arg(t)); };
+		inline double call_arctan(const std::vector<double>& t) { return std::atan(arg(t)); };
+		inline double call_sqrt  (const std::vector<double>& t) { return std::sqrt(arg(t)); };
+		inline double call_abs   (const std::vector<double>& t) { return std::fabs(arg(t)); };
+		inline double call_pow   (const std::vector<double>& t) {
+			if (t.size() == 0)
+				return 0.0;
+			if (t.size() == 1)
+				return 1.0;
+			return std::pow(t[0], t[1]);
+		};
+
+		struct builtin {
+			const char* name;
+			int argc;
+			int opcode;
+			// Entry of default_functions()
+			function call;
+		};
+
+		const builtin builtins[] = {
+			{ "sin",    1, program::SIN,    call_sin    },
+			{ "cos",    1, program::COS,    call_cos    },
+			{ "tan",    1, program::TAN,    call_tan    },
+			{ "ctan",   1, program::CTAN,   call_ctan   },
+			{ "exp",    1, program::EXP,    call_exp    },
+			{ "log",    1, program::LOG,    call_log    },
+			{ "ln",     1, program::LOG,    call_log    },
+			{ "arcsin", 1, program::ARCSIN, call_arcsin },
+			{ "arccos", 1, program::ARCCOS, call_arccos },
+			{ "arctan", 1, program::ARCTAN, call_arctan },
+			{ "sqrt",   1, program::SQRT,   call_sqrt   },
+			{ "abs",    1, program::ABS,    call_abs    },
+			{ "pow",    2, program::POW,    call_pow    }
+		};
+
+		// Returns 1 if f is entry of b in default_functions()
+		inline bool is_default(const std::function<double(const std::vector<double>&)>& f, const builtin& b) {
+			const function* target = f.target<function>();
+			return target && *target == b.call;
+		};
+
+		// Append code of f to p, depth - current depth of stack
+		void emit(program& p, func* f, const func_functions& functions, int& depth) {
+			if (f == nullptr)
+				throw std::runtime_error("compile failed: nullptr");
+
+			auto push = [&p, &depth](program::instruction in, int delta) {
+				p.code.push_back(in);
+				depth += delta;
+				if (depth > p.stack_size)
+					p.stack_size = depth;
+			};
+
+			if (const_func* t = dynamic_cast<const_func*>(f)) {
+				push({ program::CONST, 0, 0, t->val }, 1);
+				return;
+			}
+
+			if (name_func* t = dynamic_cast<name_func*>(f)) {
+				int slot = p.slot(t->name);
+				if (slot == -1)
+					throw std::invalid_argument("value for " + t->name + " not defined");
+
+				push({ program::VAR, slot, 0, 0.0 }, 1);
+				return;
+			}
+
+			if (call_func* t = dynamic_cast<call_func*>(f)) {
+				for (func* a : t->args)
+					emit(p, a, functions, depth);
+
+				auto it = functions.find(t->name);
+
+				// Function given in table replaces builtin
+				for (const builtin& b : builtins)
+					if (t->name == b.name && t->args.size() == b.argc && (it == functions.end() || is_default(it->second, b))) {
+						push({ b.opcode, 0, 0, 0.0 }, 1 - b.argc);
+						return;
+					}
+
+				if (it == functions.end())
+					throw std::invalid_argument("function for " + t->name + " not defined");
+
+				p.calls.push_back(it->second);
+				push({ program::CALL, (int) p.calls.size() - 1, (int) t->args.size(), 0.0 }, 1 - (int) t->args.size());
+				return;
+			}
+
+			if (operator_func* t = dynamic_cast<operator_func*>(f)) {
+				emit(p, t->left, functions, depth);
+
+				switch (t->opcode) {
+					case operator_func::POS: return;
+					case operator_func::NEG: push({ program::NEG, 0, 0, 0.0 }, 0); return;
+				}
+
+				emit(p, t->right, functions, depth);
+
+				switch (t->opcode) {
+					case operator_func::ADD: push({ program::ADD, 0, 0, 0.0 }, -1); return;
+					case operator_func::SUB: push({ program::SUB, 0, 0, 0.0 }, -1); return;
+					case operator_func::MUL: push({ program::MUL, 0, 0, 0.0 }, -1); return;
+					case operator_func::DIV: push({ program::DIV, 0, 0, 0.0 }, -1); return;
+					case operator_func::POW: push({ program::POW, 0, 0, 0.0 }, -1); return;
+				}
+
+				throw std::runtime_error("compile failed: undefined operation");
+			}
+
+			throw std::runtime_error("compile failed: undefined func");
+		};
+	};
+
+	// Table of builtin functions (sin, cos, tan, ctan, exp, log, ln, arcsin, arccos, arctan, sqrt, abs, pow),
+	//  calls of these entries are compiled into builtin instructions.
+	func_functions default_functions() {
+		func_functions functions;
+		for (const compiler::builtin& b : compiler::builtins)
+			functions[b.name] = b.call;
+
+		return functions;
+	};
+
+	// Compile function into bytecode.
+	// variables - names of variables, variable i is read from slots[i] on evaluation
+	// functions - table of functions, builtins are used for names that are not in table or have default_functions() entry
+	// Throws on undefined variable or function.
+	program compile(func* f, const std::vector<std::string>& variables, const func_functions& functions = func_functions()) {
+		program p;
+		p.variables = variables;
+
+		int depth = 0;
+		compiler::emit(p, f, functions, depth);
+
+		return p;
+	};
+
+	// Evaluate f over n points, columns[k] - n values of variables[k], results are written into out.
+	// threads > 1 evaluates parts in parallel.
+	// Throws on undefined variable or function.
+	void evaluate(func* f, const std::vector<std::string>& variables, const double* const* columns, std::size_t n, double* out, const func_functions& functions = func_functions(), int threads = 1) {
+		program p = compile(f, variables, functions);
+
+		if (threads > 1 && n > program::TASK_SIZE) {
+			NNSpace::ThreadPool pool(threads);
+			p.evaluate(columns, n, out, pool);
+		} else
+			p.evaluate(columns, n, out);
+	};
+};
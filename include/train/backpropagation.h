@@ -5,6 +5,9 @@
 #pragma once
 
 #include <cstdlib>
+#include <cmath>
+#include <vector>
+#include <algorithm>
 
 #include "../MultiLayerNetwork.h"
 #include "../SingleLayerNetwork.h"
@@ -17,82 +20,144 @@ namespace NNSpace {
 
 		// M U L T I L A Y E R
 		
-		// Train using backpropagation
+		// Buffers used by a single training step.
+		// Sized once from net.dimensions and reused between samples,
+		//  so training step performs no heap allocations.
+		struct TrainWorkspace {
+			// Activated outputs of layers [1-N], layers[0] is unused (input is passed directly)
+			std::vector<std::vector<double>> layers;
+			// Raw outputs of layers [1-N]
+			std::vector<std::vector<double>> layers_raw;
+			// Sigmas of layers [1-N]
+			std::vector<std::vector<double>> sigma;
+			
+			TrainWorkspace() {};
+			
+			TrainWorkspace(const NNSpace::MLNet& net) {
+				resize(net);
+			};
+			
+			// Resize buffers to match the network, no-op if dimensions are unchanged
+			void resize(const NNSpace::MLNet& net) {
+				layers.resize(net.dimensions.size());
+				layers_raw.resize(net.dimensions.size() - 1);
+				sigma.resize(net.dimensions.size() - 1);
+				
+				for (int k = 0; k < net.dimensions.size() - 1; ++k) {
+					layers[k + 1].resize(net.dimensions[k + 1]);
+					layers_raw[k].resize(net.dimensions[k + 1]);
+					sigma[k].resize(net.dimensions[k + 1]);
+				}
+			};
+		};
+		
+		// Perform training of the network and calculating error value on the output layer
 		// Assume input, output_teach size match input, output layer size
 		// net          - input network to train
+		// ws           - workspace buffers, resized to match net if needed
 		// input        - input data to train on
 		// output_teach - desired output result
 		// rate         - teach rate value
-		void train(NNSpace::MLNet& net, const std::vector<double>& input, const std::vector<double>& output_teach, double rate) {
-			std::vector<std::vector<double>> layers(net.dimensions.size()); // [0-N]
-			layers[0] = input;
+		// Ltype        - type of error calculation:
+		//  0 - none
+		//  1 - L1
+		//  2 - L2
+		double train_error(NNSpace::MLNet& net, TrainWorkspace& ws, int Ltype, const double* input, const double* output_teach, double rate) {
+			long double out_error_value = 0.0;
+			int L = net.dimensions.size() - 1;
 			
-			std::vector<std::vector<double>> layers_raw(net.dimensions.size() - 1); // [1-N]
+			// Weights are changed
+			net.densify();
+			ws.resize(net);
 			
 			// Regular process
-			for (int k = 0; k < net.dimensions.size() - 1; ++k) {
-				layers[k + 1].resize(net.dimensions[k + 1]);
-				layers_raw[k].resize(net.dimensions[k + 1]);
+			for (int k = 0; k < L; ++k) {
+				const double* in = k == 0 ? input : ws.layers[k].data();
 				
 				// calculate RAW layer outputs & normalize them
-				for (int j = 0; j < net.dimensions[k + 1]; ++j) {
-					layers_raw[k][j] = net.enable_offsets ? net.offsets[k][j] : 0;
-					
-					for (int i = 0; i < net.dimensions[k]; ++i)
-						layers_raw[k][j] += layers[k][i] * net.W[k][i][j];
-					
-					// Normalize
-					layers[k + 1][j] = net.activators[k]->process(layers_raw[k][j]);
-				}
-			}
-			
-			// Weights correction
-			std::vector<std::vector<std::vector<double>>> dW(net.dimensions.size() - 1);
-			
-			for (int i = 0; i < net.dimensions.size() - 1; ++i) {
-				dW[i].resize(net.dimensions[i]);
-				for (int j = 0; j < net.dimensions[i]; ++j)
-					dW[i][j].resize(net.dimensions[i + 1]);
-			}
-			
-			// Offsets correction
-			std::vector<std::vector<double>> doffset(net.dimensions.size() - 1);
-			// Sigmas
-			std::vector<std::vector<double>> sigma(net.dimensions.size() - 1);
-			
-			for (int i = 0; i < net.dimensions.size() - 1; ++i) {
-				doffset[i].resize(net.dimensions[i + 1]);
-				sigma[i].resize(net.dimensions[i + 1]);
+				if (net.enable_offsets)
+					std::copy(net.offsets[k].begin(), net.offsets[k].end(), ws.layers_raw[k].begin());
+				else
+					std::fill(ws.layers_raw[k].begin(), ws.layers_raw[k].end(), 0.0);
+				
+				net.W[k].multiply(in, ws.layers_raw[k].data());
+				
+				// Normalize
+				activate_layer(net.activators[k]->getType(), ws.layers_raw[k].data(), ws.layers[k + 1].data(), net.dimensions[k + 1]);
+				net.mask_layer(k + 1, ws.layers[k + 1].data(), 1);
 			}
 			
 			// Calculate sigmas
 			for (int i = 0; i < net.dimensions.back(); ++i) { // K-2, K-1
-				double dv = output_teach[i] - layers.back()[i];
-				sigma.back()[i] = dv * net.activators.back()->derivative(layers_raw.back()[i]);
+				double dv = output_teach[i] - ws.layers.back()[i];
+				ws.sigma.back()[i] = dv;
+				
+				if (Ltype == 2)
+					out_error_value += dv * dv;
+				else if (Ltype == 1)
+					out_error_value += std::fabs(dv);
 			}
 			
-			for (int k = (net.dimensions.size() - 1) - 2; k >= 0; --k) // K-3, K-2,, ..
-				for (int i = 0; i < net.dimensions[k + 1]; ++i) {
-					for (int j = 0; j < net.dimensions[k + 2]; ++j)
-						sigma[k][i] += sigma[k + 1][j] * net.W[k + 1][i][j];
-					
-					sigma[k][i] *= net.activators[k + 0]->derivative(layers_raw[k + 1 - 1][i]); // layers_raw[k + 1]
-				}
+			multiply_derivative(net.activators.back()->getType(), ws.layers.back().data(), ws.sigma.back().data(), net.dimensions.back());
+			net.mask_layer(L, ws.sigma.back().data(), 1);
+			
+			for (int k = L - 2; k >= 0; --k) { // K-3, K-2,, ..
+				std::fill(ws.sigma[k].begin(), ws.sigma[k].end(), 0.0);
+				net.W[k + 1].multiply_transposed(ws.sigma[k + 1].data(), ws.sigma[k].data());
+				
+				multiply_derivative(net.activators[k]->getType(), ws.layers[k + 1].data(), ws.sigma[k].data(), net.dimensions[k + 1]);
+				
+				// Disabled neurons are not trained
+				net.mask_layer(k + 1, ws.sigma[k].data(), 1);
+			}
 					
 			// Calculate weights correction
-			for (int k = 0; k < net.dimensions.size() - 1; ++k)
-				for (int i = 0; i < dW[k].size(); ++i)
-					for (int j = 0; j < dW[k][i].size(); ++j)
-						net.W[k][i][j] += rate * sigma[k][j] * layers[k][i];
+			for (int k = 0; k < L; ++k)
+				net.W[k].add_outer(rate, k == 0 ? input : ws.layers[k].data(), ws.sigma[k].data());
 					
 			// Calculate offset correction
+			// Scalar update, FMA kernel would round differently on each instruction set
 			if (net.enable_offsets)
-				for (int k = 0; k < net.dimensions.size() - 1; ++k)
+				for (int k = 0; k < L; ++k)
 					for (int i = 0; i < net.dimensions[k + 1]; ++i)
-						net.offsets[k][i] += rate * sigma[k][i];
+						net.offsets[k][i] += rate * ws.sigma[k][i];
+				
+			if (Ltype == 2)
+				return std::sqrt(out_error_value / (double) net.dimensions.back());
+			else if (Ltype == 1)
+				return out_error_value / (double) net.dimensions.back();
+			return 0.0;
+		};
+		
+		double train_error(NNSpace::MLNet& net, TrainWorkspace& ws, int Ltype, const std::vector<double>& input, const std::vector<double>& output_teach, double rate) {
+			return train_error(net, ws, Ltype, input.data(), output_teach.data(), rate);
+		};
+		
+		// Train using backpropagation
+		// Assume input, output_teach size match input, output layer size
+		// net          - input network to train
+		// ws           - workspace buffers, resized to match net if needed
+		// input        - input data to train on
+		// output_teach - desired output result
+		// rate         - teach rate value
+		void train(NNSpace::MLNet& net, TrainWorkspace& ws, const std::vector<double>& input, const std::vector<double>& output_teach, double rate) {
+			train_error(net, ws, 0, input.data(), output_teach.data(), rate);
+		};
+		
+		// Train using backpropagation
+		// Assume input, output_teach size match input, output layer size
+		// Allocates temporary workspace, use TrainWorkspace overload for repeated calls
+		// net          - input network to train
+		// input        - input data to train on
+		// output_teach - desired output result
+		// rate         - teach rate value
+		void train(NNSpace::MLNet& net, const std::vector<double>& input, const std::vector<double>& output_teach, double rate) {
+			TrainWorkspace ws(net);
+			train_error(net, ws, 0, input.data(), output_teach.data(), rate);
 		};
 		
 		// Perform training of the network and calculating error value on the output layer
+		// Allocates temporary workspace, use TrainWorkspace overload for repeated calls
 		// net          - input network to train
 		// input        - input data to train on
 		// output_teach - desired output result
@@ -101,88 +166,164 @@ namespace NNSpace {
 		//  1 - L1
 		//  2 - L2
 		double train_error(NNSpace::MLNet& net, int Ltype, const std::vector<double>& input, const std::vector<double>& output_teach, double rate) {
-			long double out_error_value = 0.0;
-			std::vector<std::vector<double>> layers(net.dimensions.size()); // [0-N]
-			layers[0] = input;
+			TrainWorkspace ws(net);
+			return train_error(net, ws, Ltype, input.data(), output_teach.data(), rate);
+		};
+	
+		
+		// M I N I - B A T C H
+		
+		// Buffers used by a mini-batch training step.
+		// Each buffer holds batch rows of the layer size.
+		struct BatchWorkspace {
+			// Maximal amount of samples in batch
+			int batch = 0;
+			// Activated outputs of layers [1-N], layers[0] is unused (input is passed directly)
+			std::vector<std::vector<double>> layers;
+			// Raw outputs of layers [1-N]
+			std::vector<std::vector<double>> layers_raw;
+			// Sigmas of layers [1-N]
+			std::vector<std::vector<double>> sigma;
+			
+			BatchWorkspace() {};
+			
+			BatchWorkspace(const NNSpace::MLNet& net, int batch) {
+				resize(net, batch);
+			};
+			
+			// Resize buffers to match the network and batch size, no-op if unchanged
+			void resize(const NNSpace::MLNet& net, int batch) {
+				if (batch < this->batch)
+					batch = this->batch;
+				this->batch = batch;
+				
+				layers.resize(net.dimensions.size());
+				layers_raw.resize(net.dimensions.size() - 1);
+				sigma.resize(net.dimensions.size() - 1);
+				
+				for (int k = 0; k < net.dimensions.size() - 1; ++k) {
+					layers[k + 1].resize((std::size_t) batch * net.dimensions[k + 1]);
+					layers_raw[k].resize((std::size_t) batch * net.dimensions[k + 1]);
+					sigma[k].resize((std::size_t) batch * net.dimensions[k + 1]);
+				}
+			};
+		};
+		
+		// Perform forward and backward passes for the whole batch using matrix-matrix products.
+		// Leaves layer outputs and sigmas in ws, network is not modified.
+		// Returns sum of the per-sample error values.
+		// net           - input network
+		// ws            - workspace buffers, resized to match net and batch if needed
+		// inputs        - batch rows of input layer size
+		// outputs_teach - batch rows of output layer size
+		// batch         - amount of samples
+		// Ltype         - type of error calculation:
+		//  0 - none
+		//  1 - L1
+		//  2 - L2
+		long double propagate_batch(const NNSpace::MLNet& net, BatchWorkspace& ws, int Ltype, const double* inputs, const double* outputs_teach, int batch) {
+			int L = net.dimensions.size() - 1;
 			
-			std::vector<std::vector<double>> layers_raw(net.dimensions.size() - 1); // [1-N]
+			ws.resize(net, batch);
 			
 			// Regular process
-			for (int k = 0; k < net.dimensions.size() - 1; ++k) {
-				layers[k + 1].resize(net.dimensions[k + 1]);
-				layers_raw[k].resize(net.dimensions[k + 1]);
+			for (int k = 0; k < L; ++k) {
+				const double* in = k == 0 ? inputs : ws.layers[k].data();
+				double* raw      = ws.layers_raw[k].data();
+				int size         = net.dimensions[k + 1];
 				
 				// calculate RAW layer outputs & normalize them
-				for (int j = 0; j < net.dimensions[k + 1]; ++j) {
-					layers_raw[k][j] = net.enable_offsets ? net.offsets[k][j] : 0;
-					
-					for (int i = 0; i < net.dimensions[k]; ++i)
-						layers_raw[k][j] += layers[k][i] * net.W[k][i][j];
-					
-					// Normalize
-					layers[k + 1][j] = net.activators[k]->process(layers_raw[k][j]);
-				}
-			}
-			
-			// Weights correction
-			std::vector<std::vector<std::vector<double>>> dW(net.dimensions.size() - 1);
-			
-			for (int i = 0; i < net.dimensions.size() - 1; ++i) {
-				dW[i].resize(net.dimensions[i]);
-				for (int j = 0; j < net.dimensions[i]; ++j)
-					dW[i][j].resize(net.dimensions[i + 1]);
-			}
-			
-			// Offsets correction
-			std::vector<std::vector<double>> doffset(net.dimensions.size() - 1);
-			// Sigmas
-			std::vector<std::vector<double>> sigma(net.dimensions.size() - 1);
-			
-			for (int i = 0; i < net.dimensions.size() - 1; ++i) {
 				if (net.enable_offsets)
-					doffset[i].resize(net.dimensions[i + 1]);
-				sigma[i].resize(net.dimensions[i + 1]);
+					for (int b = 0; b < batch; ++b)
+						std::copy(net.offsets[k].begin(), net.offsets[k].end(), raw + (std::size_t) b * size);
+				else
+					std::fill(raw, raw + (std::size_t) batch * size, 0.0);
+				
+				net.W[k].multiply_batch(in, batch, raw);
+				
+				// Normalize
+				activate_layer(net.activators[k]->getType(), raw, ws.layers[k + 1].data(), batch * size);
+				net.mask_layer(k + 1, ws.layers[k + 1].data(), batch);
 			}
 			
 			// Calculate sigmas
-			for (int i = 0; i < net.dimensions.back(); ++i) { // K-2, K-1
-				double dv = output_teach[i] - layers.back()[i];
-				sigma.back()[i] = dv * net.activators.back()->derivative(layers_raw.back()[i]);
+			long double out_error_value = 0.0;
+			int out_size = net.dimensions.back();
+			
+			for (int b = 0; b < batch; ++b) {
+				long double sample_error = 0.0;
+				
+				for (int i = 0; i < out_size; ++i) {
+					std::size_t n = (std::size_t) b * out_size + i;
+					double dv = outputs_teach[n] - ws.layers.back()[n];
+					ws.sigma.back()[n] = dv;
+					
+					if (Ltype == 2)
+						sample_error += dv * dv;
+					else if (Ltype == 1)
+						sample_error += std::fabs(dv);
+				}
 				
 				if (Ltype == 2)
-					out_error_value += dv * dv;
+					out_error_value += std::sqrt(sample_error / (double) out_size);
 				else if (Ltype == 1)
-					out_error_value += std::fabs(dv);
+					out_error_value += sample_error / (double) out_size;
 			}
 			
-			for (int k = (net.dimensions.size() - 1) - 2; k >= 0; --k) // K-3, K-2,, ..
-				for (int i = 0; i < net.dimensions[k + 1]; ++i) {
-					for (int j = 0; j < net.dimensions[k + 2]; ++j)
-						sigma[k][i] += sigma[k + 1][j] * net.W[k + 1][i][j];
-					
-					sigma[k][i] *= net.activators[k + 0]->derivative(layers_raw[k + 1 - 1][i]); // layers_raw[k + 1]
-				}
-					
-			// Calculate weights correction
-			for (int k = 0; k < net.dimensions.size() - 1; ++k)
-				for (int i = 0; i < dW[k].size(); ++i)
-					for (int j = 0; j < dW[k][i].size(); ++j)
-						net.W[k][i][j] += rate * sigma[k][j] * layers[k][i];
-					
-			// Calculate offset correction
-			if (net.enable_offsets)
-				for (int k = 0; k < net.dimensions.size() - 1; ++k)
-					for (int i = 0; i < net.dimensions[k + 1]; ++i)
-						net.offsets[k][i] += rate * sigma[k][i];
+			multiply_derivative(net.activators.back()->getType(), ws.layers.back().data(), ws.sigma.back().data(), batch * out_size);
+			net.mask_layer(L, ws.sigma.back().data(), batch);
+			
+			for (int k = L - 2; k >= 0; --k) {
+				std::fill(ws.sigma[k].begin(), ws.sigma[k].begin() + (std::size_t) batch * net.dimensions[k + 1], 0.0);
+				net.W[k + 1].multiply_transposed_batch(ws.sigma[k + 1].data(), batch, ws.sigma[k].data());
 				
+				multiply_derivative(net.activators[k]->getType(), ws.layers[k + 1].data(), ws.sigma[k].data(), batch * net.dimensions[k + 1]);
 				
-			if (Ltype == 2)
-				return std::sqrt(out_error_value / (double) net.dimensions.back());
-			else if (Ltype == 1)
-				return out_error_value / (double) net.dimensions.back();
-			return 0.0;
+				// Disabled neurons are not trained
+				net.mask_layer(k + 1, ws.sigma[k].data(), batch);
+			}
+			
+			return out_error_value;
 		};
-	
+		
+		// Perform mini-batch training of the network and calculating average error value on the output layer.
+		// Forward and backward passes are done for the whole batch using matrix-matrix products,
+		//  gradients are accumulated over batch and applied by a single update, scaled by rate / batch.
+		// net           - input network to train
+		// ws            - workspace buffers, resized to match net and batch if needed
+		// inputs        - batch rows of input layer size
+		// outputs_teach - batch rows of output layer size
+		// batch         - amount of samples
+		// rate          - teach rate value
+		// Ltype         - type of error calculation:
+		//  0 - none
+		//  1 - L1
+		//  2 - L2
+		double train_batch(NNSpace::MLNet& net, BatchWorkspace& ws, int Ltype, const double* inputs, const double* outputs_teach, int batch, double rate) {
+			int L = net.dimensions.size() - 1;
+			
+			if (batch <= 0)
+				return 0.0;
+			
+			// Weights are changed
+			net.densify();
+			
+			long double out_error_value = propagate_batch(net, ws, Ltype, inputs, outputs_teach, batch);
+			
+			// Apply accumulated correction
+			double scale = rate / (double) batch;
+			
+			for (int k = 0; k < L; ++k)
+				net.W[k].add_outer_batch(scale, k == 0 ? inputs : ws.layers[k].data(), ws.sigma[k].data(), batch);
+			
+			if (net.enable_offsets)
+				for (int k = 0; k < L; ++k)
+					for (int b = 0; b < batch; ++b)
+						kernels::axpy(scale, ws.sigma[k].data() + (std::size_t) b * net.dimensions[k + 1], net.offsets[k].data(), net.dimensions[k + 1]);
+			
+			return out_error_value / (double) batch;
+		};
+		
 		
 		// S I N G L E L A Y E R
 		
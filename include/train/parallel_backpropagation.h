@@ -0,0 +1,194 @@
+/*
+ * (c) Copyright bitrate16 (GPLv3.0) 2020
+ */
+
+#pragma once
+
+#include <vector>
+#include <algorithm>
+
+#include "backpropagation.h"
+#include "../ThreadPool.h"
+
+// Multi-threaded data-parallel training of MLNet.
+namespace NNSpace {
+	namespace backpropagation {
+
+		// Per-thread buffers for parallel training
+		struct ParallelWorkspace {
+			// Forward / backward buffers of each worker
+			std::vector<BatchWorkspace> workers;
+			// Online buffers of each worker (hogwild)
+			std::vector<TrainWorkspace> online;
+			// Weights gradient of each worker
+			std::vector<std::vector<WeightMatrix>> dW;
+			// Offsets gradient of each worker
+			std::vector<std::vector<std::vector<double>>> doffsets;
+			// Sum of errors of each worker
+			std::vector<long double> errors;
+
+			ParallelWorkspace() {};
+
+			ParallelWorkspace(const NNSpace::MLNet& net, int threads) {
+				resize(net, threads);
+			};
+
+			// Resize data-parallel buffers to match network and amount of threads, no-op if unchanged
+			void resize(const NNSpace::MLNet& net, int threads) {
+				workers.resize(threads);
+				dW.resize(threads);
+				doffsets.resize(threads);
+				errors.resize(threads);
+
+				for (int t = 0; t < threads; ++t) {
+					dW[t].resize(net.W.size());
+					doffsets[t].resize(net.offsets.size());
+
+					for (int k = 0; k < net.W.size(); ++k)
+						if (dW[t][k].rows != net.W[k].rows || dW[t][k].cols != net.W[k].cols || dW[t][k].layout != net.W[k].layout)
+							dW[t][k].resize(net.W[k].rows, net.W[k].cols, net.W[k].layout);
+
+					for (int k = 0; k < net.offsets.size(); ++k)
+						doffsets[t][k].resize(net.offsets[k].size());
+				}
+			};
+
+			// Resize only online buffers used by hogwild, gradient buffers are not allocated
+			void resize_online(const NNSpace::MLNet& net, int threads) {
+				online.resize(threads);
+				errors.resize(threads);
+
+				for (int t = 0; t < threads; ++t)
+					online[t].resize(net);
+			};
+		};
+
+		// Perform data-parallel mini-batch training of the network and calculating average error value on the output layer.
+		// Batch is split into pool.size() contiguous shards, each worker computes gradient of its shard
+		//  into own buffer, buffers are summed by pairwise tree reduction and applied by a single update.
+		// Order of summation depends only on amount of threads, so result is deterministic.
+		// net           - input network to train
+		// ws            - workspace buffers, resized to match net and pool if needed
+		// pool          - worker threads
+		// inputs        - batch rows of input layer size
+		// outputs_teach - batch rows of output layer size
+		// batch         - amount of samples
+		// rate          - teach rate value
+		// Ltype         - type of error calculation:
+		//  0 - none
+		//  1 - L1
+		//  2 - L2
+		double train_batch_parallel(NNSpace::MLNet& net, ParallelWorkspace& ws, ThreadPool& pool, int Ltype, const double* inputs, const double* outputs_teach, int batch, double rate) {
+			int L       = net.dimensions.size() - 1;
+			int threads = std::min(pool.size(), batch);
+			int in_size  = net.dimensions.front();
+			int out_size = net.dimensions.back();
+
+			if (batch <= 0)
+				return 0.0;
+
+			// Weights are changed
+			net.densify();
+			ws.resize(net, threads);
+
+			// Gradients of shards
+			pool.parallel_for(threads, [&](int t) {
+				int from  = (int) ((long) batch * t / threads);
+				int count = (int) ((long) batch * (t + 1) / threads) - from;
+
+				const double* in = inputs + (std::size_t) from * in_size;
+				ws.errors[t] = propagate_batch(net, ws.workers[t], Ltype, in, outputs_teach + (std::size_t) from * out_size, count);
+
+				for (int k = 0; k < L; ++k) {
+					std::fill(ws.dW[t][k].data.begin(), ws.dW[t][k].data.end(), 0.0);
+					ws.dW[t][k].add_outer_batch(1.0, k == 0 ? in : ws.workers[t].layers[k].data(), ws.workers[t].sigma[k].data(), count);
+
+					if (net.enable_offsets) {
+						std::fill(ws.doffsets[t][k].begin(), ws.doffsets[t][k].end(), 0.0);
+						for (int b = 0; b < count; ++b)
+							kernels::axpy(1.0, ws.workers[t].sigma[k].data() + (std::size_t) b * net.dimensions[k + 1], ws.doffsets[t][k].data(), net.dimensions[k + 1]);
+					}
+				}
+			});
+
+			// Tree reduction, dW[t] += dW[t + stride]
+			for (int stride = 1; stride < threads; stride *= 2) {
+				int pairs = (threads - stride + 2 * stride - 1) / (2 * stride);
+
+				pool.parallel_for(pairs, [&](int p) {
+					int t = p * 2 * stride;
+
+					for (int k = 0; k < L; ++k) {
+						kernels::axpy(1.0, ws.dW[t + stride][k].raw(), ws.dW[t][k].raw(), ws.dW[t][k].size());
+
+						if (net.enable_offsets)
+							kernels::axpy(1.0, ws.doffsets[t + stride][k].data(), ws.doffsets[t][k].data(), net.dimensions[k + 1]);
+					}
+
+					ws.errors[t] += ws.errors[t + stride];
+				});
+			}
+
+			// Apply accumulated correction, each layer is split between threads
+			double scale = rate / (double) batch;
+
+			for (int k = 0; k < L; ++k) {
+				std::size_t size = net.W[k].size();
+
+				pool.parallel_for(threads, [&](int t) {
+					std::size_t from = size * t / threads;
+					std::size_t to   = size * (t + 1) / threads;
+					kernels::axpy(scale, ws.dW[0][k].raw() + from, net.W[k].raw() + from, to - from);
+				});
+
+				if (net.enable_offsets)
+					kernels::axpy(scale, ws.doffsets[0][k].data(), net.offsets[k].data(), net.dimensions[k + 1]);
+			}
+
+			return ws.errors[0] / (double) batch;
+		};
+
+		// Perform Hogwild-style lock-free training of the network and calculating average error value on the output layer.
+		// Samples are split into pool.size() contiguous shards, each worker performs online training
+		//  on its shard and updates shared weights without any synchronization.
+		// Updates from different threads may overwrite each other, so result is not deterministic.
+		// net           - input network to train
+		// ws            - workspace buffers, resized to match net and pool if needed
+		// pool          - worker threads
+		// inputs        - count rows of input layer size
+		// outputs_teach - count rows of output layer size
+		// count         - amount of samples
+		// rate          - teach rate value
+		// Ltype         - type of error calculation:
+		//  0 - none
+		//  1 - L1
+		//  2 - L2
+		double train_hogwild(NNSpace::MLNet& net, ParallelWorkspace& ws, ThreadPool& pool, int Ltype, const double* inputs, const double* outputs_teach, int count, double rate) {
+			int threads  = std::min(pool.size(), count);
+			int in_size  = net.dimensions.front();
+			int out_size = net.dimensions.back();
+
+			if (count <= 0)
+				return 0.0;
+
+			// Weights are changed, workers see dense network
+			net.densify();
+			ws.resize_online(net, threads);
+
+			pool.parallel_for(threads, [&](int t) {
+				int from = (int) ((long) count * t / threads);
+				int to   = (int) ((long) count * (t + 1) / threads);
+
+				ws.errors[t] = 0.0;
+				for (int i = from; i < to; ++i)
+					ws.errors[t] += train_error(net, ws.online[t], Ltype, inputs + (std::size_t) i * in_size, outputs_teach + (std::size_t) i * out_size, rate);
+			});
+
+			long double error = 0.0;
+			for (int t = 0; t < threads; ++t)
+				error += ws.errors[t];
+
+			return error / (double) count;
+		};
+	};
+};
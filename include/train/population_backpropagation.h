@@ -0,0 +1,266 @@
+/*
+ * (c) Copyright bitrate16 (GPLv3.0) 2020
+ */
+
+#pragma once
+
+#include <vector>
+#include <algorithm>
+
+#include "backpropagation.h"
+
+// Training of the population of networks with the same topology on the same samples.
+namespace NNSpace {
+	namespace backpropagation {
+
+		// Weights of K networks with the same topology stacked into single tensor per layer.
+		// Layer 0 is stored as [i][p][j] (rows x K * cols), so the shared input is multiplied
+		//  by all networks with a single kernel call.
+		// Layers k > 0 are stored as K contiguous blocks [p][i][j].
+		// Layer buffers are stored as [p][j], so activation is done for whole population at once.
+		struct PopulationTensor {
+			// Amount of networks
+			int K = 0;
+			// Topology of the networks
+			std::vector<int> dimensions;
+			// Offsets flag
+			bool enable_offsets = 0;
+			// Activator of each layer
+			std::vector<ActivatorType> types;
+			// Stacked weights
+			std::vector<WeightMatrix::buffer_type> W;
+			// Stacked offsets, [p][j]
+			std::vector<std::vector<double>> offsets;
+			// Stacked masks of active neurons of layers [1-N], [p][j], empty if all neurons of layer are active
+			std::vector<std::vector<uint8_t>> mask;
+			// Activated outputs of layers [1-N], layers[0] is unused (input is shared)
+			std::vector<std::vector<double>> layers;
+			// Raw outputs of layers [1-N]
+			std::vector<std::vector<double>> layers_raw;
+			// Sigmas of layers [1-N]
+			std::vector<std::vector<double>> sigma;
+
+			PopulationTensor() {};
+
+			PopulationTensor(const std::vector<NNSpace::MLNet>& nets) {
+				load(nets);
+			};
+
+			// Zero values of disabled neurons in [p][j] buffer of layer k + 1
+			inline void mask_layer(int k, double* values) const {
+				if (mask[k].empty())
+					return;
+
+				for (std::size_t n = 0; n < mask[k].size(); ++n)
+					if (!mask[k][n])
+						values[n] = 0.0;
+			};
+
+			// Index of weight W[i][j] of network p in layer k
+			inline std::size_t index(int k, int p, int i, int j) const {
+				if (k == 0)
+					return ((std::size_t) i * K + p) * dimensions[1] + j;
+				return ((std::size_t) p * dimensions[k] + i) * dimensions[k + 1] + j;
+			};
+
+			// Copy weights of the networks into tensor.
+			// Returns 0 if networks have different topology or activators.
+			bool load(const std::vector<NNSpace::MLNet>& nets) {
+				std::vector<int> ids(nets.size());
+				for (int p = 0; p < ids.size(); ++p)
+					ids[p] = p;
+
+				return load(nets, ids);
+			};
+
+			// Copy weights of the networks nets[ids[p]] into tensor.
+			// Returns 0 if networks have different topology or activators.
+			bool load(const std::vector<NNSpace::MLNet>& nets, const std::vector<int>& ids) {
+				if (ids.empty())
+					return 0;
+
+				const NNSpace::MLNet& first = nets[ids[0]];
+
+				for (int id : ids) {
+					const NNSpace::MLNet& n = nets[id];
+
+					if (n.dimensions != first.dimensions || n.enable_offsets != first.enable_offsets)
+						return 0;
+
+					for (int k = 0; k < n.dimensions.size() - 1; ++k)
+						if (n.activators[k]->getType() != first.activators[k]->getType())
+							return 0;
+				}
+
+				K              = ids.size();
+				dimensions     = first.dimensions;
+				enable_offsets = first.enable_offsets;
+
+				int L = dimensions.size() - 1;
+				types.resize(L);
+				W.resize(L);
+				offsets.resize(L);
+				mask.assign(L, {});
+				layers.resize(L + 1);
+				layers_raw.resize(L);
+				sigma.resize(L);
+
+				for (int k = 0; k < L; ++k) {
+					types[k] = first.activators[k]->getType();
+
+					W[k].resize((std::size_t) K * dimensions[k] * dimensions[k + 1]);
+					offsets[k].resize((std::size_t) K * dimensions[k + 1]);
+					layers[k + 1].resize((std::size_t) K * dimensions[k + 1]);
+					layers_raw[k].resize((std::size_t) K * dimensions[k + 1]);
+					sigma[k].resize((std::size_t) K * dimensions[k + 1]);
+
+					for (int p = 0; p < K; ++p) {
+						for (int i = 0; i < dimensions[k]; ++i)
+							for (int j = 0; j < dimensions[k + 1]; ++j)
+								W[k][index(k, p, i, j)] = nets[ids[p]].W[k].at(i, j);
+
+						if (enable_offsets)
+							std::copy(nets[ids[p]].offsets[k].begin(), nets[ids[p]].offsets[k].end(), offsets[k].begin() + (std::size_t) p * dimensions[k + 1]);
+					}
+
+					for (int p = 0; p < K; ++p)
+						if (nets[ids[p]].activeCount(k + 1) != dimensions[k + 1]) {
+							mask[k].resize((std::size_t) K * dimensions[k + 1]);
+							for (int q = 0; q < K; ++q)
+								for (int j = 0; j < dimensions[k + 1]; ++j)
+									mask[k][(std::size_t) q * dimensions[k + 1] + j] = nets[ids[q]].isActive(k + 1, j);
+							break;
+						}
+				}
+
+				return 1;
+			};
+
+			// Copy weights from tensor back into networks loaded by load()
+			void store(std::vector<NNSpace::MLNet>& nets) const {
+				std::vector<int> ids(K);
+				for (int p = 0; p < K; ++p)
+					ids[p] = p;
+
+				store(nets, ids);
+			};
+
+			// Copy weights from tensor back into networks nets[ids[p]] loaded by load()
+			void store(std::vector<NNSpace::MLNet>& nets, const std::vector<int>& ids) const {
+				for (int k = 0; k < dimensions.size() - 1; ++k)
+					for (int p = 0; p < K; ++p) {
+						nets[ids[p]].densify();
+
+						for (int i = 0; i < dimensions[k]; ++i)
+							for (int j = 0; j < dimensions[k + 1]; ++j)
+								nets[ids[p]].W[k].at(i, j) = W[k][index(k, p, i, j)];
+
+						if (enable_offsets)
+							std::copy(offsets[k].begin() + (std::size_t) p * dimensions[k + 1], offsets[k].begin() + (std::size_t) (p + 1) * dimensions[k + 1], nets[ids[p]].offsets[k].begin());
+					}
+			};
+		};
+
+		// Perform training of all networks of the population on single sample and calculating error value of each network.
+		// Input is converted once and shared by all networks, each layer is processed for the whole population.
+		// pop          - population to train
+		// input        - input data to train on
+		// output_teach - desired output result
+		// rates        - teach rate value of each network
+		// errors       - error value of each network, may be nullptr
+		// Ltype        - type of error calculation:
+		//  0 - none
+		//  1 - L1
+		//  2 - L2
+		void train_population(PopulationTensor& pop, int Ltype, const double* input, const double* output_teach, const double* rates, double* errors) {
+			int L = pop.dimensions.size() - 1;
+			int K = pop.K;
+
+			// Regular process
+			for (int k = 0; k < L; ++k) {
+				int rows  = pop.dimensions[k];
+				int cols  = pop.dimensions[k + 1];
+				double* raw = pop.layers_raw[k].data();
+
+				if (pop.enable_offsets)
+					std::copy(pop.offsets[k].begin(), pop.offsets[k].end(), raw);
+				else
+					std::fill(raw, raw + (std::size_t) K * cols, 0.0);
+
+				if (k == 0)
+					kernels::gemv_n(pop.W[0].data(), rows, K * cols, input, raw);
+				else
+					for (int p = 0; p < K; ++p)
+						kernels::gemv_n(pop.W[k].data() + (std::size_t) p * rows * cols, rows, cols, pop.layers[k].data() + (std::size_t) p * rows, raw + (std::size_t) p * cols);
+
+				activate_layer(pop.types[k], raw, pop.layers[k + 1].data(), K * cols);
+				pop.mask_layer(k, pop.layers[k + 1].data());
+			}
+
+			// Calculate sigmas
+			int out_size = pop.dimensions.back();
+
+			for (int p = 0; p < K; ++p) {
+				long double out_error_value = 0.0;
+
+				for (int i = 0; i < out_size; ++i) {
+					std::size_t n = (std::size_t) p * out_size + i;
+					double dv = output_teach[i] - pop.layers.back()[n];
+					pop.sigma.back()[n] = dv;
+
+					if (Ltype == 2)
+						out_error_value += dv * dv;
+					else if (Ltype == 1)
+						out_error_value += std::fabs(dv);
+				}
+
+				if (errors)
+					errors[p] = Ltype == 2 ? std::sqrt(out_error_value / (double) out_size) : Ltype == 1 ? out_error_value / (double) out_size : 0.0;
+			}
+
+			multiply_derivative(pop.types.back(), pop.layers.back().data(), pop.sigma.back().data(), K * out_size);
+			pop.mask_layer(L - 1, pop.sigma.back().data());
+
+			for (int k = L - 2; k >= 0; --k) {
+				int rows = pop.dimensions[k + 1];
+				int cols = pop.dimensions[k + 2];
+
+				std::fill(pop.sigma[k].begin(), pop.sigma[k].end(), 0.0);
+				for (int p = 0; p < K; ++p)
+					kernels::gemv_t(pop.W[k + 1].data() + (std::size_t) p * rows * cols, rows, cols, pop.sigma[k + 1].data() + (std::size_t) p * cols, pop.sigma[k].data() + (std::size_t) p * rows);
+
+				multiply_derivative(pop.types[k], pop.layers[k + 1].data(), pop.sigma[k].data(), K * rows);
+
+				// Disabled neurons are not trained
+				pop.mask_layer(k, pop.sigma[k].data());
+			}
+
+			// Scale sigmas by rate of each network
+			for (int k = 0; k < L; ++k) {
+				int cols = pop.dimensions[k + 1];
+
+				for (int p = 0; p < K; ++p)
+					for (int j = 0; j < cols; ++j)
+						pop.sigma[k][(std::size_t) p * cols + j] *= rates[p];
+			}
+
+			// Calculate weights correction
+			for (int k = 0; k < L; ++k) {
+				int rows = pop.dimensions[k];
+				int cols = pop.dimensions[k + 1];
+
+				if (k == 0)
+					for (int i = 0; i < rows; ++i)
+						kernels::axpy(input[i], pop.sigma[0].data(), pop.W[0].data() + (std::size_t) i * K * cols, K * cols);
+				else
+					for (int p = 0; p < K; ++p)
+						for (int i = 0; i < rows; ++i)
+							kernels::axpy(pop.layers[k][(std::size_t) p * rows + i], pop.sigma[k].data() + (std::size_t) p * cols, pop.W[k].data() + ((std::size_t) p * rows + i) * cols, cols);
+
+				// Calculate offset correction
+				if (pop.enable_offsets)
+					kernels::axpy(1.0, pop.sigma[k].data(), pop.offsets[k].data(), K * cols);
+			}
+		};
+	};
+};
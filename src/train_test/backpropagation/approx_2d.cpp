@@ -2,7 +2,8 @@
 #include <vector>
 #include <chrono>
 
-#include "train/backpropagation.h"
+#include "train/parallel_backpropagation.h"
+#include "DataStream.h"
 #include "NetTestCommon.h"
 #include "pargs.h"
 
@@ -15,16 +16,21 @@
  *  --activator=[%]  Activator[i] function type
  *  --weight=%       Weight dispersion
  *  --offsets=%      Enable offfsets flag
- *  --train=%        Input train set
+ *  --train=%        Input train set, streamed from file by chunks during training
  *  --test=%         Input test set
  *  --output=%       Output file for the network
+ *  --binary=%       Write output network in binary format
  *  --rate_factor=%  Scale factor for rate value
  *  --rate=%         Constant rate value
  *  --Ltype=%        L1 or L2
+ *  --batch=%        Mini-batch size, 1 for online training (default)
+ *  --threads=%      Amount of training threads, > 1 requires --batch (data-parallel mini-batch training)
+ *                   or --hogwild
+ *  --hogwild=%      Lock-free parallel online training, updates of threads are not synchronized
  *  --log=[%]        Log type (TRAIN_TIME, TRAIN_OPERATIONS, TRAIN_ITERATIONS, TEST_ERROR_AVG, TEST_ERROR_MAX)
  *
  * Make:
- * g++ src/train_test/backpropagation/approx_2d.cpp -o bin/backpropagation_approx_2d -O3 --std=c++17 -Iinclude -lstdc++fs
+ * g++ src/train_test/backpropagation/approx_2d.cpp -o bin/backpropagation_approx_2d -O3 --std=c++17 -Iinclude -lstdc++fs -pthread
  *
  * Example:
  * ./bin/backpropagation_approx_2d --layers=[3] --offsets=true --activator=TanH --rate_factor=0.5 --weight=1.0 --train=data/sin_1000.mset --test=data/sin_100.mset --output=networks/approx_sin.neetwook --log=[TRAIN_TIME,TEST_ERROR_AVG,TEST_ERROR_MAX,TRAIN_ITERATIONS]
@@ -34,6 +40,9 @@
  * 
  */
 
+// Amount of samples read from train set at once
+const int STREAM_CHUNK = 65536;
+
 // Simply prints out the message and exits.
 inline void exit_message(const std::string& message) {
 	if (message.size())
@@ -79,14 +88,32 @@ int main(int argc, const char** argv) {
 	if (Ltype != 1 && Ltype != 2)
 		Ltype = 1;
 	
+	// Read threads count
+	int threads = args["--threads"] ? args["--threads"]->get_integer() : 1;
+	if (threads < 1)
+		threads = 1;
+	
+	bool hogwild = args["--hogwild"] && args["--hogwild"]->get_boolean();
+	
+	// Read mini-batch size
+	int batch = args["--batch"] ? args["--batch"]->get_integer() : 1;
+	if (batch < 1)
+		batch = 1;
+	
+	// Amount of threads does not change optimized function, batch must be given explicitly
+	if (threads > 1 && batch == 1 && !hogwild)
+		exit_message("--threads requires --batch > 1 for data-parallel training or --hogwild for parallel online training");
+	
 	// Read test & train set
 	std::string train = args["--train"] && args["--train"]->is_string() ? args["--train"]->string() : "train.mset";
 	std::string test  = args["--test"]  && args["--test"]->is_string()  ? args["--test"]->string()  : "test.mset";
 	
-	// Read train set data
-	std::vector<std::pair<double, double>> train_set;
-	if (!NNSpace::Common::read_approx_set(train_set, train))
+	// Open train set, it is not loaded into memory
+	NNSpace::SetSource train_set;
+	if (!train_set.open(train))
 		exit_message("Set " + train + " not found");
+	if (train_set.size() && train_set.input_size() != 1)
+		exit_message("Invalid train set " + train);
 	
 	std::vector<std::pair<double, double>> test_set;
 	if (!NNSpace::Common::read_approx_set(test_set,  test))
@@ -104,12 +131,18 @@ int main(int argc, const char** argv) {
 			if (args["--activator"]->string() == "BipolarSigmoid")  network.setActivator(new NNSpace::BipolarSigmoid());
 			if (args["--activator"]->string() == "ReLU")            network.setActivator(new NNSpace::ReLU()          );
 			if (args["--activator"]->string() == "TanH")            network.setActivator(new NNSpace::TanH()          );
+			if (args["--activator"]->string() == "FastSigmoid")     network.setActivator(new NNSpace::FastSigmoid()   );
+			if (args["--activator"]->string() == "FastBipolarSigmoid") network.setActivator(new NNSpace::FastBipolarSigmoid());
+			if (args["--activator"]->string() == "FastTanH")        network.setActivator(new NNSpace::FastTanH()      );
 		} else if (args["--activator"]->is_integer()) {
 			if (args["--activator"]->integer() == NNSpace::ActivatorType::LINEAR)          network.setActivator(new NNSpace::Linear()        );
 			if (args["--activator"]->integer() == NNSpace::ActivatorType::SIGMOID)         network.setActivator(new NNSpace::Sigmoid()       );
 			if (args["--activator"]->integer() == NNSpace::ActivatorType::BIPOLAR_SIGMOID) network.setActivator(new NNSpace::BipolarSigmoid());
 			if (args["--activator"]->integer() == NNSpace::ActivatorType::RELU)            network.setActivator(new NNSpace::ReLU()          );
 			if (args["--activator"]->integer() == NNSpace::ActivatorType::TANH)            network.setActivator(new NNSpace::TanH()          );
+			if (args["--activator"]->integer() == NNSpace::ActivatorType::SIGMOID_FAST)    network.setActivator(new NNSpace::FastSigmoid()   );
+			if (args["--activator"]->integer() == NNSpace::ActivatorType::BIPOLAR_SIGMOID_FAST) network.setActivator(new NNSpace::FastBipolarSigmoid());
+			if (args["--activator"]->integer() == NNSpace::ActivatorType::TANH_FAST)       network.setActivator(new NNSpace::FastTanH()      );
 		} else if (args["--activator"]->is_array()) {
 			for (int i = 0; i < args["--activator"]->array().size(); ++i) {
 				if (args["--activator"]->array()[i]->is_string()) {
@@ -118,12 +151,18 @@ int main(int argc, const char** argv) {
 					if (args["--activator"]->array()[i]->string() == "BipolarSigmoid")  network.setActivator(new NNSpace::BipolarSigmoid());
 					if (args["--activator"]->array()[i]->string() == "ReLU")            network.setActivator(new NNSpace::ReLU()          );
 					if (args["--activator"]->array()[i]->string() == "TanH")            network.setActivator(new NNSpace::TanH()          );
+					if (args["--activator"]->array()[i]->string() == "FastSigmoid")     network.setActivator(new NNSpace::FastSigmoid()   );
+					if (args["--activator"]->array()[i]->string() == "FastBipolarSigmoid") network.setActivator(new NNSpace::FastBipolarSigmoid());
+					if (args["--activator"]->array()[i]->string() == "FastTanH")        network.setActivator(new NNSpace::FastTanH()      );
 				} else if (args["--activator"]->array()[i]->is_integer()) {
 					if (args["--activator"]->array()[i]->integer() == NNSpace::ActivatorType::LINEAR)          network.setActivator(new NNSpace::Linear()        );
 					if (args["--activator"]->array()[i]->integer() == NNSpace::ActivatorType::SIGMOID)         network.setActivator(new NNSpace::Sigmoid()       );
 					if (args["--activator"]->array()[i]->integer() == NNSpace::ActivatorType::BIPOLAR_SIGMOID) network.setActivator(new NNSpace::BipolarSigmoid());
 					if (args["--activator"]->array()[i]->integer() == NNSpace::ActivatorType::RELU)            network.setActivator(new NNSpace::ReLU()          );
 					if (args["--activator"]->array()[i]->integer() == NNSpace::ActivatorType::TANH)            network.setActivator(new NNSpace::TanH()          );
+					if (args["--activator"]->array()[i]->integer() == NNSpace::ActivatorType::SIGMOID_FAST)    network.setActivator(new NNSpace::FastSigmoid()   );
+					if (args["--activator"]->array()[i]->integer() == NNSpace::ActivatorType::BIPOLAR_SIGMOID_FAST) network.setActivator(new NNSpace::FastBipolarSigmoid());
+					if (args["--activator"]->array()[i]->integer() == NNSpace::ActivatorType::TANH_FAST)       network.setActivator(new NNSpace::FastTanH()      );
 				}
 			}
 		}
@@ -131,19 +170,66 @@ int main(int argc, const char** argv) {
 	
 	// Perform testing
 	auto start_time = std::chrono::high_resolution_clock::now();
-	unsigned long train_iterations = train_set.size();
+	unsigned long train_iterations = 0;
 	
 	double rate = 0.5;
-	std::vector<double> input(1);
-	std::vector<double> output(1);
-	
-	for (auto& p : train_set) {
-		input[0]  = p.first;
-		output[0] = p.second;
-		if (has_rate)
-			NNSpace::backpropagation::train_error(network, Ltype, input, output, rate_constant * rate_factor);
-		else
-			rate = NNSpace::backpropagation::train_error(network, Ltype, input, output, rate * rate_factor);
+	
+	// Training buffers, allocated once
+	NNSpace::backpropagation::TrainWorkspace workspace(network);
+	
+	if (batch == 1 && !hogwild) {
+		NNSpace::DataStream stream(train_set, STREAM_CHUNK);
+		
+		while (const NNSpace::DataStream::Chunk* chunk = stream.next()) {
+			train_iterations += chunk->count;
+			
+			for (int i = 0; i < chunk->count; ++i) {
+				if (has_rate)
+					NNSpace::backpropagation::train_error(network, workspace, Ltype, chunk->inputs.data() + i, chunk->outputs.data() + i, rate_constant * rate_factor);
+				else
+					rate = NNSpace::backpropagation::train_error(network, workspace, Ltype, chunk->inputs.data() + i, chunk->outputs.data() + i, rate * rate_factor);
+			}
+		}
+		
+		if (stream.failed())
+			exit_message("Failed reading train set after " + std::to_string(train_iterations) + " samples");
+	} else {
+		NNSpace::backpropagation::BatchWorkspace batch_workspace;
+		NNSpace::backpropagation::ParallelWorkspace parallel_workspace;
+		NNSpace::ThreadPool pool(threads);
+		
+		// Hogwild splits chunk between threads
+		if (hogwild && batch == 1)
+			batch = 256 * threads;
+		
+		// Chunk holds whole amount of batches, so batches are the same as without streaming
+		NNSpace::DataStream stream(train_set, batch * std::max(1, STREAM_CHUNK / batch));
+		
+		while (const NNSpace::DataStream::Chunk* chunk = stream.next()) {
+			train_iterations += chunk->count;
+			
+			for (int i = 0; i < chunk->count; i += batch) {
+				int count = std::min(batch, chunk->count - i);
+				const double* inputs  = chunk->inputs.data() + i;
+				const double* outputs = chunk->outputs.data() + i;
+				
+				double step_rate = has_rate ? rate_constant * rate_factor : rate * rate_factor;
+				double error;
+				
+				if (hogwild)
+					error = NNSpace::backpropagation::train_hogwild(network, parallel_workspace, pool, Ltype, inputs, outputs, count, step_rate);
+				else if (threads > 1)
+					error = NNSpace::backpropagation::train_batch_parallel(network, parallel_workspace, pool, Ltype, inputs, outputs, count, step_rate);
+				else
+					error = NNSpace::backpropagation::train_batch(network, batch_workspace, Ltype, inputs, outputs, count, step_rate);
+				
+				if (!has_rate)
+					rate = error;
+			}
+		}
+		
+		if (stream.failed())
+			exit_message("Failed reading train set after " + std::to_string(train_iterations) + " samples");
 	}
 	
 	auto end_time = std::chrono::high_resolution_clock::now();
@@ -166,7 +252,7 @@ int main(int argc, const char** argv) {
 	
 	// Write network to file
 	if (args["--output"] && args["--output"]->is_string())
-		NNSpace::Common::write_network(network, args["--output"]->string());
+		NNSpace::Common::write_network(network, args["--output"]->string(), args["--binary"] && args["--binary"]->get_boolean());
 	
 	return 0;
 };
\ No newline at end of file
@@ -2,7 +2,8 @@
 #include <vector>
 #include <chrono>
 
-#include "train/backpropagation.h"
+#include "train/parallel_backpropagation.h"
+#include "DataStream.h"
 #include "NetTestCommon.h"
 #include "pargs.h"
 
@@ -23,13 +24,18 @@
  *  --train_offset=% Offset value for train set
  *  --test_offset=%  Offset value for test set
  *  --output=%       Output file for the network
+ *  --binary=%       Write output network in binary format
  *  --rate_factor=%  Scale factor for rate value
  *  --rate=%         Constant rate value
  *  --Ltype=%        L1 or L2
+ *  --batch=%        Mini-batch size, 1 for online training (default)
+ *  --threads=%      Amount of training threads, > 1 requires --batch (data-parallel mini-batch training)
+ *                   or --hogwild
+ *  --hogwild=%      Lock-free parallel online training, updates of threads are not synchronized
  *  --log=[%]        Log type (TRAIN_TIME, TRAIN_OPERATIONS, TRAIN_ITERATIONS, TEST_ERROR_AVG, TEST_ERROR_MAX, TEST_MATCH)
  *
  * Make:
- * g++ src/train_test/backpropagation/mnist.cpp -o bin/backpropagation_mnist -O3 --std=c++17 -Iinclude -lstdc++fs
+ * g++ src/train_test/backpropagation/mnist.cpp -o bin/backpropagation_mnist -O3 --std=c++17 -Iinclude -lstdc++fs -pthread
  *
  * Example:
  * ./bin/backpropagation_mnist --layers=[3] --train_size=10000 --test_size=100 --offsets=true --activator=TanH --rate_factor=0.5 --weight=1.0 --mnist=data/mnist --output=networks/mnist_test.neetwook --log=[TRAIN_TIME,TEST_ERROR_AVG,TEST_ERROR_MAX,TRAIN_ITERATIONS,TEST_MATCH]
@@ -44,6 +50,9 @@
  * ./bin/backpropagation_mnist --layers=[100] --train_size=50000 --test_size=1000 --offsets=true --activator=Sigmoid --rate=0.2 --weight=1.0 --mnist=data/mnist --output=networks/mnist_test.neetwook --log=[TRAIN_TIME,TEST_ERROR_AVG,TEST_ERROR_MAX,TRAIN_ITERATIONS,TEST_MATCH]
  */
 
+// Amount of training images read at once
+const int STREAM_CHUNK = 4096;
+
 // Simply prints out the message and exits.
 inline void exit_message(const std::string& message) {
 	if (message.size())
@@ -88,11 +97,27 @@ int main(int argc, const char** argv) {
 	if (Ltype != 1 && Ltype != 2)
 		Ltype = 1;
 	
+	// Read threads count
+	int threads = args["--threads"] ? args["--threads"]->get_integer() : 1;
+	if (threads < 1)
+		threads = 1;
+	
+	bool hogwild = args["--hogwild"] && args["--hogwild"]->get_boolean();
+	
+	// Read mini-batch size
+	int batch = args["--batch"] ? args["--batch"]->get_integer() : 1;
+	if (batch < 1)
+		batch = 1;
+	
+	// Amount of threads does not change optimized function, batch must be given explicitly
+	if (threads > 1 && batch == 1 && !hogwild)
+		exit_message("--threads requires --batch > 1 for data-parallel training or --hogwild for parallel online training");
+	
 	// Read set
 	std::string mnist_path = args["--mnist"] && args["--mnist"]->is_string() ? args["--mnist"]->string() : "mnist";
 	
 	// Read set
-	mnist::MNIST_dataset<std::vector, std::vector<uint8_t>, uint8_t> set;
+	NNSpace::MnistSet set;
 	if (!NNSpace::Common::load_mnist(set, mnist_path))
 		exit_message("Set " + mnist_path + " not found");
 	
@@ -113,6 +138,14 @@ int main(int argc, const char** argv) {
 	if (test_offset < 0 || test_size <= 0 || test_offset + test_size > set.test_images.size())
 		exit_message("Invalid test offset or size");
 	
+	// Convert testing images once
+	set.normalize_test(test_offset, test_size);
+	
+	// Training images are streamed from files by chunks
+	NNSpace::MnistSource train_set;
+	if (!train_set.open(mnist_path, train_offset, train_size))
+		exit_message("Set " + mnist_path + " not found");
+	
 	// Generate network
 	NNSpace::MLNet network;
 	NNSpace::Common::generate_random_network(network, dimensions, wD, offsets);
@@ -125,12 +158,18 @@ int main(int argc, const char** argv) {
 			if (args["--activator"]->string() == "BipolarSigmoid")  network.setActivator(new NNSpace::BipolarSigmoid());
 			if (args["--activator"]->string() == "ReLU")            network.setActivator(new NNSpace::ReLU()          );
 			if (args["--activator"]->string() == "TanH")            network.setActivator(new NNSpace::TanH()          );
+			if (args["--activator"]->string() == "FastSigmoid")     network.setActivator(new NNSpace::FastSigmoid()   );
+			if (args["--activator"]->string() == "FastBipolarSigmoid") network.setActivator(new NNSpace::FastBipolarSigmoid());
+			if (args["--activator"]->string() == "FastTanH")        network.setActivator(new NNSpace::FastTanH()      );
 		} else if (args["--activator"]->is_integer()) {
 			if (args["--activator"]->integer() == NNSpace::ActivatorType::LINEAR)          network.setActivator(new NNSpace::Linear()        );
 			if (args["--activator"]->integer() == NNSpace::ActivatorType::SIGMOID)         network.setActivator(new NNSpace::Sigmoid()       );
 			if (args["--activator"]->integer() == NNSpace::ActivatorType::BIPOLAR_SIGMOID) network.setActivator(new NNSpace::BipolarSigmoid());
 			if (args["--activator"]->integer() == NNSpace::ActivatorType::RELU)            network.setActivator(new NNSpace::ReLU()          );
 			if (args["--activator"]->integer() == NNSpace::ActivatorType::TANH)            network.setActivator(new NNSpace::TanH()          );
+			if (args["--activator"]->integer() == NNSpace::ActivatorType::SIGMOID_FAST)    network.setActivator(new NNSpace::FastSigmoid()   );
+			if (args["--activator"]->integer() == NNSpace::ActivatorType::BIPOLAR_SIGMOID_FAST) network.setActivator(new NNSpace::FastBipolarSigmoid());
+			if (args["--activator"]->integer() == NNSpace::ActivatorType::TANH_FAST)       network.setActivator(new NNSpace::FastTanH()      );
 		} else if (args["--activator"]->is_array()) {
 			for (int i = 0; i < args["--activator"]->array().size(); ++i) {
 				if (args["--activator"]->array()[i]->is_string()) {
@@ -139,12 +178,18 @@ int main(int argc, const char** argv) {
 					if (args["--activator"]->array()[i]->string() == "BipolarSigmoid")  network.setActivator(new NNSpace::BipolarSigmoid());
 					if (args["--activator"]->array()[i]->string() == "ReLU")            network.setActivator(new NNSpace::ReLU()          );
 					if (args["--activator"]->array()[i]->string() == "TanH")            network.setActivator(new NNSpace::TanH()          );
+					if (args["--activator"]->array()[i]->string() == "FastSigmoid")     network.setActivator(new NNSpace::FastSigmoid()   );
+					if (args["--activator"]->array()[i]->string() == "FastBipolarSigmoid") network.setActivator(new NNSpace::FastBipolarSigmoid());
+					if (args["--activator"]->array()[i]->string() == "FastTanH")        network.setActivator(new NNSpace::FastTanH()      );
 				} else if (args["--activator"]->array()[i]->is_integer()) {
 					if (args["--activator"]->array()[i]->integer() == NNSpace::ActivatorType::LINEAR)          network.setActivator(new NNSpace::Linear()        );
 					if (args["--activator"]->array()[i]->integer() == NNSpace::ActivatorType::SIGMOID)         network.setActivator(new NNSpace::Sigmoid()       );
 					if (args["--activator"]->array()[i]->integer() == NNSpace::ActivatorType::BIPOLAR_SIGMOID) network.setActivator(new NNSpace::BipolarSigmoid());
 					if (args["--activator"]->array()[i]->integer() == NNSpace::ActivatorType::RELU)            network.setActivator(new NNSpace::ReLU()          );
 					if (args["--activator"]->array()[i]->integer() == NNSpace::ActivatorType::TANH)            network.setActivator(new NNSpace::TanH()          );
+					if (args["--activator"]->array()[i]->integer() == NNSpace::ActivatorType::SIGMOID_FAST)    network.setActivator(new NNSpace::FastSigmoid()   );
+					if (args["--activator"]->array()[i]->integer() == NNSpace::ActivatorType::BIPOLAR_SIGMOID_FAST) network.setActivator(new NNSpace::FastBipolarSigmoid());
+					if (args["--activator"]->array()[i]->integer() == NNSpace::ActivatorType::TANH_FAST)       network.setActivator(new NNSpace::FastTanH()      );
 				}
 			}
 		}
@@ -152,25 +197,69 @@ int main(int argc, const char** argv) {
 	
 	// Perform testing
 	auto start_time = std::chrono::high_resolution_clock::now();
-	unsigned long train_iterations = train_size;
+	unsigned long train_iterations = 0;
 	
 	double rate = 0.5;
-	std::vector<double> input(28 * 28);
-	std::vector<double> output(10, 0);
 	
-	for (int i = train_offset; i < train_offset + train_size; ++i) {
-		// Convert input
-		for (int k = 0; k < 28 * 28; ++k)
-			input[k] = (double) set.training_images[i][k] * (1.0 / 255.0);
+	// Training buffers, allocated once
+	NNSpace::backpropagation::TrainWorkspace workspace(network);
+	
+	if (batch == 1 && !hogwild) {
+		NNSpace::DataStream stream(train_set, STREAM_CHUNK);
 		
-		output[set.training_labels[i]] = 1.0;
+		while (const NNSpace::DataStream::Chunk* chunk = stream.next()) {
+			train_iterations += chunk->count;
+			
+			for (int i = 0; i < chunk->count; ++i) {
+				const double* in     = chunk->inputs.data() + (std::size_t) i * 28 * 28;
+				const double* output = chunk->outputs.data() + i * 10;
+				
+				if (has_rate)
+					NNSpace::backpropagation::train_error(network, workspace, Ltype, in, output, rate_constant * rate_factor);
+				else
+					rate = NNSpace::backpropagation::train_error(network, workspace, Ltype, in, output, rate * rate_factor);
+			}
+		}
+		
+		if (stream.failed())
+			exit_message("Failed reading train images after " + std::to_string(train_iterations) + " samples");
+	} else {
+		NNSpace::backpropagation::BatchWorkspace batch_workspace;
+		NNSpace::backpropagation::ParallelWorkspace parallel_workspace;
+		NNSpace::ThreadPool pool(threads);
+		
+		// Hogwild splits chunk between threads
+		if (hogwild && batch == 1)
+			batch = 256 * threads;
 		
-		if (has_rate)
-			NNSpace::backpropagation::train_error(network, Ltype, input, output, rate_constant * rate_factor);
-		else
-			rate = NNSpace::backpropagation::train_error(network, Ltype, input, output, rate * rate_factor);
+		// Chunk holds whole amount of batches, so batches are the same as without streaming
+		NNSpace::DataStream stream(train_set, batch * std::max(1, STREAM_CHUNK / batch));
+		
+		while (const NNSpace::DataStream::Chunk* chunk = stream.next()) {
+			train_iterations += chunk->count;
+			
+			for (int i = 0; i < chunk->count; i += batch) {
+				int count = std::min(batch, chunk->count - i);
+				const double* in      = chunk->inputs.data() + (std::size_t) i * 28 * 28;
+				const double* outputs = chunk->outputs.data() + i * 10;
+				
+				double step_rate = has_rate ? rate_constant * rate_factor : rate * rate_factor;
+				double error;
+				
+				if (hogwild)
+					error = NNSpace::backpropagation::train_hogwild(network, parallel_workspace, pool, Ltype, in, outputs, count, step_rate);
+				else if (threads > 1)
+					error = NNSpace::backpropagation::train_batch_parallel(network, parallel_workspace, pool, Ltype, in, outputs, count, step_rate);
+				else
+					error = NNSpace::backpropagation::train_batch(network, batch_workspace, Ltype, in, outputs, count, step_rate);
+				
+				if (!has_rate)
+					rate = error;
+			}
+		}
 		
-		output[set.training_labels[i]] = 0.0;
+		if (stream.failed())
+			exit_message("Failed reading train images after " + std::to_string(train_iterations) + " samples");
 	}
 	
 	auto end_time = std::chrono::high_resolution_clock::now();
@@ -195,7 +284,7 @@ int main(int argc, const char** argv) {
 	
 	// Write network to file
 	if (args["--output"] && args["--output"]->is_string())
-		NNSpace::Common::write_network(network, args["--output"]->string());
+		NNSpace::Common::write_network(network, args["--output"]->string(), args["--binary"] && args["--binary"]->get_boolean());
 	
 	return 0;
 };
\ No newline at end of file
@@ -0,0 +1,43 @@
+#include "NetTestCommon.h"
+#include "pargs.h"
+
+#include <iostream>
+
+/*
+ * (c) Copyright bitrate16 (GPLv3.0) 2020
+ * Converts approximation set between text and binary columnar formats
+ * Agruments:
+ *  --input=%        Input set, format is detected automatically
+ *  --output=%       Output filename
+ *  --binary=%       Write set in binary columnar format, text otherwise
+ *
+ * Make:
+ * g++ src/train_test/convert_set.cpp -o bin/convert_set -O3 --std=c++17 -Iinclude -lstdc++fs
+ *
+ * Example:
+ * ./bin/convert_set --input=data/sin_100000.mset --output=data/sin_100000.bin.mset --binary=true
+ */
+
+int main(int argc, const char** argv) {
+	pargs::pargs args(argc, argv);
+
+	if (!args["--input"] || !args["--input"]->is_string() || !args["--output"] || !args["--output"]->is_string()) {
+		std::cout << "Input and output required" << std::endl;
+		return 0;
+	}
+
+	std::string input  = args["--input"]->string();
+	std::string output = args["--output"]->string();
+	bool binary        = args["--binary"] && args["--binary"]->get_boolean();
+
+	std::vector<std::pair<std::vector<double>, double>> set;
+	if (!NNSpace::Common::read_approx_set(set, input)) {
+		std::cout << "Set " << input << " not found" << std::endl;
+		return 0;
+	}
+
+	if (!NNSpace::Common::write_approx_set(set, output, binary))
+		std::cout << "Failed output to " << output << std::endl;
+
+	return 0;
+};
@@ -23,6 +23,7 @@
 #include <cmath>
 
 #include "MultiLayerNetwork.h"
+#include "math_func_compile.h"
 #include "math_func_util.h"
 #include "math_func.h"
 #include "pargs.h"
@@ -47,12 +48,14 @@ public:
 	double off   = 0.0;
 	double offv  = 0.0;
 	
-	std::map<std::string, double> values;
 	std::map<std::string, std::function<double(const std::vector<double>&)>> functions;
 	math_func::func* back_func = nullptr;
+	math_func::program back_program;
 	
 	// Generated on resize, point set to render graph
 	std::vector<double> point_set;
+	// Values of background function on point set
+	std::vector<double> back_set;
 	
 	bool mouse_down = 0;
 	bool resized    = 0;
@@ -67,42 +70,18 @@ public:
 		get_plot_set();
 		
 		// Init default functions
-		functions["sin"] = [](std::vector<double> t) {
-			return std::sin(t.size() == 0 ? 0.0 : t[0]);
-		};
-		functions["cos"] = [](std::vector<double> t) {
-			return std::cos(t.size() == 0 ? 0.0 : t[0]);
-		};
-		functions["tan"] = [](std::vector<double> t) {
-			return std::tan(t.size() == 0 ? 0.0 : t[0]);
-		};
-		functions["ctan"] = [](std::vector<double> t) {
-			return std::cos(t.size() == 0 ? 0.0 : t[0]) / std::sin(t.size() == 0 ? 0.0 : t[0]);
-		};
-		functions["exp"] = [](std::vector<double> t) {
-			return std::exp(t.size() == 0 ? 0.0 : t[0]);
-		};
-		functions["pow"] = [](std::vector<double> t) {
-			if (t.size() == 0)
-				return 0.0;
-			if (t.size() == 1)
-				return 1.0;
-			return std::pow(t[0], t[1]);
-		};
-		functions["log"] = [](std::vector<double> t) {
-			if (t.size() == 0)
-				return 0.0;
-			return std::log(t[0]);
-		};
-		functions["arcsin"] = [](std::vector<double> t) {
-			return std::asin(t.size() == 0 ? 0.0 : t[0]);
-		};
-		functions["arccos"] = [](std::vector<double> t) {
-			return std::acos(t.size() == 0 ? 0.0 : t[0]);
-		};
-		functions["arctan"] = [](std::vector<double> t) {
-			return std::atan(t.size() == 0 ? 0.0 : t[0]);
-		};
+		functions = math_func::default_functions();
+		
+		// Compile background function with t in slot 0
+		if (back_func)
+			try {
+				back_program = math_func::compile(back_func, { "t" }, functions);
+				get_back_set();
+			} catch (const std::exception& e) {
+				std::cout << "Error compiling function: " << e.what() << std::endl;
+				delete back_func;
+				back_func = nullptr;
+			}
 		
 		reload();
 	};
@@ -118,6 +97,18 @@ public:
 		int i = 0;
 		for (double d = start - interval * off + step; d < end + interval * off - step; d += step)
 			point_set[i++] = d;
+		
+		get_back_set();
+	};
+	
+	// Evaluate background function over whole point set
+	void get_back_set() {
+		if (!back_func || back_program.code.empty())
+			return;
+		
+		const double* t = point_set.data();
+		back_set.resize(point_set.size());
+		back_program.evaluate(&t, point_set.size(), back_set.data());
 	};
 	
 	// Does reloading of the network from path
@@ -203,8 +194,7 @@ public:
 					
 					// Render background function
 					p.color(255, 255, 0);
-					values["t"] = point_set[i];
-					double e = back_func->evaluate(values, functions);
+					double e = back_set[i];
 					y = get_window().get_height() - get_window().get_height() * ((e + 1.0) * (0.5 - offv) + offv);
 					p.point(x, y);
 					
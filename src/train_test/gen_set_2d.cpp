@@ -1,3 +1,4 @@
+#include "math_func_compile.h"
 #include "math_func_util.h"
 #include "NetTestCommon.h"
 #include "math_func.h"
@@ -15,12 +16,16 @@
  *  --count=%        Points count
  *  --output=%       Output filename
  *  --random=%       Use random instead of linear
+ *  --binary=%       Write set in binary columnar format
+ *  --threads=%      Amount of threads evaluating function
  *
  * Make:
- * g++ src/train_test/gen_set_2d.cpp -o bin/gen_set_2d -O3 --std=c++17 -Iinclude -lstdc++fs
+ * g++ src/train_test/gen_set_2d.cpp -o bin/gen_set_2d -O3 --std=c++17 -Iinclude -lstdc++fs -pthread
  *
  * Example:
  * ./bin/gen_set_2d --function="sin(t*3.14*2.0)*0.5+0.5" --count=1000 --output=data/sin_1000.mset --random=true
+ * 
+ * ./bin/gen_set_2d --function="sin(t*3.14*2.0)*0.5+0.5" --count=10000000 --output=data/sin_10000000.mset --random=true --binary=true --threads=4
  */
 
 int main(int argc, const char** argv) {
@@ -32,6 +37,8 @@ int main(int argc, const char** argv) {
 	std::string function = args["--function"] && args["--function"]->is_string() ? args["--function"]->string() : "t";
 	int count            = args["--count"]    && args["--count"]->is_integer()   ? args["--count"]->integer()   : 100;
 	bool random          = args["--random"]   && args["--random"]->get_boolean();
+	bool binary          = args["--binary"]   && args["--binary"]->get_boolean();
+	int threads          = args["--threads"]  && args["--threads"]->is_integer()  ? args["--threads"]->integer()  : 1;
 	
 	// Check valid data
 	if (start >= end) {
@@ -54,56 +61,29 @@ int main(int argc, const char** argv) {
 	math_func::func* opt = math_func::optimize(func);
 	delete func;
 	
-	std::map<std::string, double> values;
-	std::map<std::string, std::function<double(const std::vector<double>&)>> functions;
-	
 	// Init default functions
-	functions["sin"] = [](std::vector<double> t) {
-		return std::sin(t.size() == 0 ? 0.0 : t[0]);
-	};
-	functions["cos"] = [](std::vector<double> t) {
-		return std::cos(t.size() == 0 ? 0.0 : t[0]);
-	};
-	functions["tan"] = [](std::vector<double> t) {
-		return std::tan(t.size() == 0 ? 0.0 : t[0]);
-	};
-	functions["ctan"] = [](std::vector<double> t) {
-		return std::cos(t.size() == 0 ? 0.0 : t[0]) / std::sin(t.size() == 0 ? 0.0 : t[0]);
-	};
-	functions["exp"] = [](std::vector<double> t) {
-		return std::exp(t.size() == 0 ? 0.0 : t[0]);
-	};
-	functions["pow"] = [](std::vector<double> t) {
-		if (t.size() == 0)
-			return 0.0;
-		if (t.size() == 1)
-			return 1.0;
-		return std::pow(t[0], t[1]);
-	};
-	functions["log"] = [](std::vector<double> t) {
-		if (t.size() == 0)
-			return 0.0;
-		return std::log(t[0]);
-	};
-	functions["arcsin"] = [](std::vector<double> t) {
-		return std::asin(t.size() == 0 ? 0.0 : t[0]);
-	};
-	functions["arccos"] = [](std::vector<double> t) {
-		return std::acos(t.size() == 0 ? 0.0 : t[0]);
-	};
-	functions["arctan"] = [](std::vector<double> t) {
-		return std::atan(t.size() == 0 ? 0.0 : t[0]);
-	};
+	std::map<std::string, std::function<double(const std::vector<double>&)>> functions = math_func::default_functions();
 
-	// Generate desired set
+	// Compile function with t in slot 0
+	math_func::program program;
+	try {
+		program = math_func::compile(opt, { "t" }, functions);
+	} catch (const std::exception& e) {
+		std::cout << "Error compiling function: " << e.what() << std::endl;
+		return 0;
+	}
+	
+	delete opt;
+	
+	// Generate desired set, function is evaluated over all points
+	NNSpace::ThreadPool pool(std::max(1, threads));
 	std::vector<std::pair<double, double>> set;
-	NNSpace::Common::gen_approx_fun(set, [&values, &functions, &opt](double t) {
-		values["t"] = t;
-		return opt->evaluate(values, functions);
+	NNSpace::Common::gen_approx_fun(set, [&program, &pool](const double* t, std::size_t n, double* y) {
+		program.evaluate(&t, n, y, pool);
 	}, start, end, count, random);
 	
 	// Write output set
-	if (!NNSpace::Common::write_approx_set(set, output))
+	if (!NNSpace::Common::write_approx_set(set, output, binary))
 		std::cout << "Failed output to " << output << std::endl;
 	
 	return 0;
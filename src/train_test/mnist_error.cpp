@@ -36,7 +36,7 @@ int main(int argc, const char** argv) {
 	std::string mnist_path = args["--mnist"] && args["--mnist"]->is_string() ? args["--mnist"]->string() : "mnist";
 	
 	// Read set
-	mnist::MNIST_dataset<std::vector, std::vector<uint8_t>, uint8_t> set;
+	NNSpace::MnistSet set;
 	if (!NNSpace::Common::load_mnist(set, mnist_path))
 		exit_message("Set " + mnist_path + " not found");
 	
@@ -51,6 +51,9 @@ int main(int argc, const char** argv) {
 	if (test_offset < 0 || test_size <= 0 || test_offset + test_size > set.test_images.size())
 		exit_message("Invalid test offset or size");
 	
+	// Convert testing images once
+	set.normalize_test(test_offset, test_size);
+	
 	std::cout << "TEST_MATCH=" << NNSpace::Common::calculate_mnist_match(network, set, test_offset, test_size) << std::endl;
 	std::cout << "TEST_ERROR_AVG=" << NNSpace::Common::calculate_mnist_error(network, set, Ltype, test_offset, test_size) << std::endl;
 	std::cout << "TEST_ERROR_MAX=" << NNSpace::Common::calculate_mnist_error_max(network, set, Ltype, test_offset, test_size) << std::endl;
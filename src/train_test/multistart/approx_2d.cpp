@@ -2,8 +2,14 @@
 #include <vector>
 #include <chrono>
 #include <limits>
+#include <atomic>
 
 #include "train/backpropagation.h"
+#include "train/population_backpropagation.h"
+#include "ThreadPool.h"
+#include "Population.h"
+#include "AshaScheduler.h"
+#include "Checkpoint.h"
 #include "NetTestCommon.h"
 #include "pargs.h"
 
@@ -24,14 +30,25 @@
  *  --train=%        Input train set
  *  --test=%         Input test set
  *  --output=%       Output file for the network
+ *  --binary=%       Write output network in binary format
  *  --Ltype=%        L1 or L2
  *  --rate_factor=%  Scale factor for rate value
  *  --rate=%         Constant rate value
  *  --networks=%     Cmount of startup networks
+ *  --threads=%      Amount of threads training networks concurrently
+ *  --population=%   Train all networks as single stacked population tensor,
+ *                   every sample is converted once and passed through all networks by shared kernels
+ *  --asha=%         Asynchronous successive halving, networks are promoted to the next subset
+ *                   as soon as they are in top 1 / eta of networks reported on their subset,
+ *                   may train more networks on later subsets than synchronous halving
+ *  --eta=%          Reduction factor for asha, default is 2
+ *  --checkpoint=%   Checkpoint file, population state is written in background after each epoch,
+ *                   can not be used with --asha
+ *  --resume=%       Checkpoint file to continue training from, can not be used with --asha
  *  --log=[%]        Log type (TRAIN_TIME, TRAIN_OPERATIONS, TRAIN_ITERATIONS, TEST_ERROR_AVG, TEST_ERROR_MAX)
  *
  * Make:
- * g++ src/train_test/multistart/approx_2d.cpp -o bin/multistart_approx_2d -O3 --std=c++17 -Iinclude -lstdc++fs
+ * g++ src/train_test/multistart/approx_2d.cpp -o bin/multistart_approx_2d -O3 --std=c++17 -Iinclude -lstdc++fs -pthread
  *
  * Example:
  * ./bin/multistart_approx_2d --networks=16 --layers=[3] --offsets=true --activator=TanH --rate_factor=0.5 --weight=1.0 --train=data/sin_1000.mset --test=data/sin_100.mset --output=networks/approx_sin.neetwook --log=[TRAIN_TIME,TEST_ERROR_AVG,TEST_ERROR_MAX,TRAIN_ITERATIONS]
@@ -83,6 +100,22 @@ int main(int argc, const char** argv) {
 	if (count <= 0)
 		exit_message("Invalid networks count");
 	
+	// Read threads count
+	int threads = args["--threads"] ? args["--threads"]->get_integer() : 1;
+	if (threads < 1)
+		threads = 1;
+	
+	// Read population mode flag
+	bool population_mode = args["--population"] && args["--population"]->get_boolean();
+	
+	// Read asha flag and reduction factor
+	bool asha = args["--asha"] && args["--asha"]->get_boolean();
+	int eta   = args["--eta"] ? args["--eta"]->get_integer() : 2;
+	
+	// Read checkpoint files
+	std::string checkpoint = args["--checkpoint"] && args["--checkpoint"]->is_string() ? args["--checkpoint"]->string() : "";
+	std::string resume     = args["--resume"]     && args["--resume"]->is_string()     ? args["--resume"]->string()     : "";
+	
 	// Read Ltype
 	int Ltype = args["--Ltype"] ? args["--Ltype"]->get_integer() : 1;
 	if (Ltype != 1 && Ltype != 2)
@@ -102,15 +135,17 @@ int main(int argc, const char** argv) {
 	
 	// Read train set data
 	std::vector<std::vector<std::pair<double, double>>> train_sets;
+	int subset_size = 0;
 	{
 		std::vector<std::pair<double, double>> train_set;
 		if (!NNSpace::Common::read_approx_set(train_set, train))
 			exit_message("Set " + train + " not found");
 		
-		if (train_set.size() / (Af + 1) == 0)
+		subset_size = train_set.size() / (Af + 1);
+		if (subset_size == 0)
 			exit_message("Not enough train set size");
 		
-		NNSpace::Common::split_approx_set(train_sets, train_set, train_set.size() / (Af + 1));
+		NNSpace::Common::split_approx_set(train_sets, train_set, subset_size);
 	}
 	
 	std::vector<std::pair<double, double>> test_set;
@@ -130,12 +165,18 @@ int main(int argc, const char** argv) {
 				if (args["--activator"]->string() == "BipolarSigmoid")  networks[i].setActivator(new NNSpace::BipolarSigmoid());
 				if (args["--activator"]->string() == "ReLU")            networks[i].setActivator(new NNSpace::ReLU()          );
 				if (args["--activator"]->string() == "TanH")            networks[i].setActivator(new NNSpace::TanH()          );
+				if (args["--activator"]->string() == "FastSigmoid")     networks[i].setActivator(new NNSpace::FastSigmoid()   );
+				if (args["--activator"]->string() == "FastBipolarSigmoid") networks[i].setActivator(new NNSpace::FastBipolarSigmoid());
+				if (args["--activator"]->string() == "FastTanH")        networks[i].setActivator(new NNSpace::FastTanH()      );
 			} else if (args["--activator"]->is_integer()) {
 				if (args["--activator"]->integer() == NNSpace::ActivatorType::LINEAR)          networks[i].setActivator(new NNSpace::Linear()        );
 				if (args["--activator"]->integer() == NNSpace::ActivatorType::SIGMOID)         networks[i].setActivator(new NNSpace::Sigmoid()       );
 				if (args["--activator"]->integer() == NNSpace::ActivatorType::BIPOLAR_SIGMOID) networks[i].setActivator(new NNSpace::BipolarSigmoid());
 				if (args["--activator"]->integer() == NNSpace::ActivatorType::RELU)            networks[i].setActivator(new NNSpace::ReLU()          );
 				if (args["--activator"]->integer() == NNSpace::ActivatorType::TANH)            networks[i].setActivator(new NNSpace::TanH()          );
+				if (args["--activator"]->integer() == NNSpace::ActivatorType::SIGMOID_FAST)    networks[i].setActivator(new NNSpace::FastSigmoid()   );
+				if (args["--activator"]->integer() == NNSpace::ActivatorType::BIPOLAR_SIGMOID_FAST) networks[i].setActivator(new NNSpace::FastBipolarSigmoid());
+				if (args["--activator"]->integer() == NNSpace::ActivatorType::TANH_FAST)       networks[i].setActivator(new NNSpace::FastTanH()      );
 			} else if (args["--activator"]->is_array()) {
 				for (int i = 0; i < args["--activator"]->array().size(); ++i) {
 					if (args["--activator"]->array()[i]->is_string()) {
@@ -144,12 +185,18 @@ int main(int argc, const char** argv) {
 						if (args["--activator"]->array()[i]->string() == "BipolarSigmoid") networks[i].setActivator(new NNSpace::BipolarSigmoid());
 						if (args["--activator"]->array()[i]->string() == "ReLU")            networks[i].setActivator(new NNSpace::ReLU()          );
 						if (args["--activator"]->array()[i]->string() == "TanH")            networks[i].setActivator(new NNSpace::TanH()          );
+						if (args["--activator"]->array()[i]->string() == "FastSigmoid")     networks[i].setActivator(new NNSpace::FastSigmoid()   );
+						if (args["--activator"]->array()[i]->string() == "FastBipolarSigmoid") networks[i].setActivator(new NNSpace::FastBipolarSigmoid());
+						if (args["--activator"]->array()[i]->string() == "FastTanH")        networks[i].setActivator(new NNSpace::FastTanH()      );
 					} else if (args["--activator"]->array()[i]->is_integer()) {
 						if (args["--activator"]->array()[i]->integer() == NNSpace::ActivatorType::LINEAR)          networks[i].setActivator(new NNSpace::Linear()        );
 						if (args["--activator"]->array()[i]->integer() == NNSpace::ActivatorType::SIGMOID)         networks[i].setActivator(new NNSpace::Sigmoid()       );
 						if (args["--activator"]->array()[i]->integer() == NNSpace::ActivatorType::BIPOLAR_SIGMOID) networks[i].setActivator(new NNSpace::BipolarSigmoid());
 						if (args["--activator"]->array()[i]->integer() == NNSpace::ActivatorType::RELU)            networks[i].setActivator(new NNSpace::ReLU()          );
 						if (args["--activator"]->array()[i]->integer() == NNSpace::ActivatorType::TANH)            networks[i].setActivator(new NNSpace::TanH()          );
+						if (args["--activator"]->array()[i]->integer() == NNSpace::ActivatorType::SIGMOID_FAST)    networks[i].setActivator(new NNSpace::FastSigmoid()   );
+						if (args["--activator"]->array()[i]->integer() == NNSpace::ActivatorType::BIPOLAR_SIGMOID_FAST) networks[i].setActivator(new NNSpace::FastBipolarSigmoid());
+						if (args["--activator"]->array()[i]->integer() == NNSpace::ActivatorType::TANH_FAST)       networks[i].setActivator(new NNSpace::FastTanH()      );
 					}
 				}
 			}
@@ -160,86 +207,188 @@ int main(int argc, const char** argv) {
 	auto start_time = std::chrono::high_resolution_clock::now();
 	unsigned long train_iterations = 0;
 	
-	std::vector<double> input(1);
-	std::vector<double> output(1);
-	
-	// Training rate value
-	std::vector<double> rates(networks.size(), 0.5);
-	// Testing error value
-	// a - before train
-	// b - after train
-	// d - error delta
-	std::vector<double> errors_a(networks.size(), 0.5);
-	std::vector<double> errors_b(networks.size(), 0.5);
-	std::vector<double> errors_d(networks.size(), 0.5);
+	// Networks with training rate and testing error values, pruning does not move them
+	NNSpace::Population population(std::move(networks), 0.5, 0.5);
+	
+	// First epoch to run
+	int start_epoch = 0;
+	
+	// Checkpoint is valid only for the same amount of networks and split of train set
+	NNSpace::checkpoint::Schedule schedule;
+	schedule.networks    = count;
+	schedule.rounds      = Af;
+	schedule.subset_size = subset_size;
+	
+	// Successive halving has no epochs to checkpoint
+	if (asha && (checkpoint.size() || resume.size()))
+		exit_message("--checkpoint and --resume can not be used with --asha");
+	
+	// Restore population state
+	if (resume.size()) {
+		NNSpace::checkpoint::Schedule stored;
+		if (!NNSpace::checkpoint::load_population(resume, population, stored, start_epoch, train_iterations))
+			exit_message("Failed to resume from " + resume);
+		
+		if (stored != schedule)
+			exit_message("Checkpoint " + resume + " was written for " + std::to_string(stored.networks) + " networks, "
+				+ std::to_string(stored.rounds) + " halving rounds and train subsets of " + std::to_string(stored.subset_size) + " samples");
+	}
+	
+	// Writes checkpoints in background
+	NNSpace::checkpoint::AsyncWriter checkpoint_writer;
+	
+	// Training buffers of each network, allocated once
+	std::vector<NNSpace::backpropagation::TrainWorkspace> workspaces(population.networks.size());
+	std::vector<std::vector<double>> inputs(population.networks.size(), std::vector<double>(1));
+	std::vector<std::vector<double>> outputs(population.networks.size(), std::vector<double>(1));
+	
+	// Networks are independent, so they are trained concurrently
+	NNSpace::ThreadPool pool(threads);
+	
+	// Population mode buffers
+	NNSpace::backpropagation::PopulationTensor population_tensor;
+	std::vector<double> population_rates(population.networks.size());
+	std::vector<double> population_errors(population.networks.size());
+	
 	// Maximal error value 
 	double error_min = 0.0;
 	// Minimal Error delta
 	double varie_max = 2.0;
 	// Index array for sorting the networks by their errro value
-	std::vector<int> index_array(networks.size());
+	std::vector<int> index_array(population.size());
+	
+	// Train network id on subset epo with backpropagation
+	auto train_network = [&](int id, int epo) {
+		NNSpace::MLNet& network     = population.networks[id];
+		std::vector<double>& input  = inputs[id];
+		std::vector<double>& output = outputs[id];
+		
+		for (auto& p : train_sets[epo]) {
+			input[0]  = p.first;
+			output[0] = p.second;
+			if (has_rate)
+				NNSpace::backpropagation::train_error(network, workspaces[id], Ltype, input, output, rate_constant * rate_factor);
+			else
+				population.rates[id] = NNSpace::backpropagation::train_error(network, workspaces[id], Ltype, input, output, population.rates[id] * rate_factor);
+		}
+	};
+	
+	// Calculate error value of network id on testing set
+	auto test_network = [&](int id) {
+		population.errors_b[id] = NNSpace::Common::calculate_approx_error(population.networks[id], test_set, Ltype);
+	};
+	
+	// Asynchronous successive halving, each thread takes next job as soon as it is done with previous one
+	if (asha) {
+		NNSpace::AshaScheduler scheduler(population.size(), Af + 1, eta);
+		std::atomic<unsigned long> asha_iterations(0);
+		
+		pool.parallel_for(pool.size(), [&](int) {
+			NNSpace::AshaScheduler::Job job;
+			
+			while (scheduler.next(job)) {
+				population.errors_a[job.id] = population.errors_b[job.id];
+				
+				train_network(job.id, job.rung);
+				test_network(job.id);
+				
+				asha_iterations += train_sets[job.rung].size();
+				scheduler.report(job, population.errors_b[job.id]);
+			}
+		});
+		
+		train_iterations = asha_iterations;
+		
+		// Keep only the best network
+		population.active.assign(1, scheduler.best());
+	}
 	
 	// Iterate over epochs
-	for (int epo = 0; epo < (Af + 1); ++epo) {
+	for (int epo = start_epoch; !asha && epo < (Af + 1); ++epo) {
 		error_min      = std::numeric_limits<long double>::max();
 		varie_max      = 0.0;
 		
-		for (int k = 0; k < networks.size(); ++k) {
-			errors_a[k]    = errors_b[k];
-			index_array[k] = k;
+		// Train all networks at once, falls back to separate training if topologies differ
+		bool stacked = population_mode && population_tensor.load(population.networks, population.active);
+		
+		if (stacked) {
+			std::vector<double>& input  = inputs[0];
+			std::vector<double>& output = outputs[0];
 			
-			// Train with backpropagation
 			for (auto& p : train_sets[epo]) {
 				input[0]  = p.first;
 				output[0] = p.second;
-				if (has_rate)
-					NNSpace::backpropagation::train_error(networks[k], Ltype, input, output, rate_constant * rate_factor);
-				else
-					rates[k] = NNSpace::backpropagation::train_error(networks[k], Ltype, input, output, rates[k] * rate_factor);
+				
+				for (int k = 0; k < population.size(); ++k)
+					population_rates[k] = has_rate ? rate_constant * rate_factor : population.rates[population.active[k]] * rate_factor;
+				
+				NNSpace::backpropagation::train_population(population_tensor, Ltype, input.data(), output.data(), population_rates.data(), population_errors.data());
+				
+				if (!has_rate)
+					for (int k = 0; k < population.size(); ++k)
+						population.rates[population.active[k]] = population_errors[k];
 			}
 			
-			train_iterations += train_sets[epo].size();
+			population_tensor.store(population.networks, population.active);
+		}
+		
+		pool.parallel_for(population.size(), [&](int k) {
+			int id = population.active[k];
+			
+			population.errors_a[id] = population.errors_b[id];
+			
+			// Train with backpropagation
+			if (!stacked)
+				train_network(id, epo);
 			
 			// Calculate error value on testing set
-			errors_b[k] = NNSpace::Common::calculate_approx_error(networks[k], test_set, Ltype);
-			errors_d[k] = errors_b[k] - errors_a[k];
+			test_network(id);
+		});
+		
+		for (int k = 0; k < population.size(); ++k) {
+			int id = population.active[k];
+			population.errors_d[id] = population.errors_b[id] - population.errors_a[id];
+			index_array[k]          = k;
+			
+			train_iterations += train_sets[epo].size();
 			
 			// Update min/max
-			if (varie_max < errors_d[k])
-				varie_max = errors_d[k];
-			if (error_min > errors_b[k])
-				error_min = errors_b[k];
+			if (varie_max < population.errors_d[id])
+				varie_max = population.errors_d[id];
+			if (error_min > population.errors_b[id])
+				error_min = population.errors_b[id];
 		}
 		
 		if (epo == Af)
 			break;
 		
 		// Order networks by their testing error value
-		std::sort(index_array.begin(), index_array.end(), [&errors_d, &errors_b, &error_min, &varie_max](const int& a, const int& b) {
-			return 	(varie_max - errors_d[a] + errors_b[a] - error_min)  // Distance from A to error values
+		std::sort(index_array.begin(), index_array.end(), [&population, &error_min, &varie_max](const int& a, const int& b) {
+			int ia = population.active[a];
+			int ib = population.active[b];
+			return 	(varie_max - population.errors_d[ia] + population.errors_b[ia] - error_min)  // Distance from A to error values
 					>
-					(varie_max - errors_d[b] + errors_b[b] - error_min); // Distance from B to error values
+					(varie_max - population.errors_d[ib] + population.errors_b[ib] - error_min); // Distance from B to error values
 		});
 		
 		// Reduce amount of networks by 2
 		int slice_size = index_array.size() / 2 + index_array.size() % 2;
 		
-		// Slice half of an array and sort because removing 
-		//  unordered indexes is undefined behaviour.
-		std::vector<int> index_array_ordered(index_array.begin(), index_array.begin() + slice_size);
-		std::sort(index_array_ordered.begin(), index_array_ordered.end(), [](const int& a, const int& b) { return a > b; });
-		
-		for (int i = 0; i < slice_size; ++i) {
-			networks.erase(networks.begin() + index_array_ordered[i]);
-			rates   .erase(rates   .begin() + index_array_ordered[i]);
-			errors_a.erase(errors_a.begin() + index_array_ordered[i]);
-			errors_b.erase(errors_b.begin() + index_array_ordered[i]);
-			errors_d.erase(errors_d.begin() + index_array_ordered[i]);
-		}
+		// Remove worst half in single pass, order of the rest is kept
+		population.remove(std::vector<int>(index_array.begin(), index_array.begin() + slice_size));
 		
 		index_array.resize(index_array.size() - slice_size);
+		
+		// Save state for the next epoch, checkpointing stops after failed write
+		if (checkpoint.size() && !checkpoint_writer.write_async(checkpoint, NNSpace::checkpoint::save_population(population, schedule, epo + 1, train_iterations))) {
+			std::cout << "Failed writing checkpoint " << checkpoint << std::endl;
+			checkpoint.clear();
+		}
 	}
 	
+	if (checkpoint.size() && !checkpoint_writer.flush())
+		std::cout << "Failed writing checkpoint " << checkpoint << std::endl;
+	
 	auto end_time = std::chrono::high_resolution_clock::now();
 	
 	// Do logging of the requested values
@@ -253,14 +402,14 @@ int main(int argc, const char** argv) {
 		if (args["--log"]->array_contains("TRAIN_ITERATIONS"))
 			std::cout << "TRAIN_ITERATIONS=" << train_iterations << std::endl;
 		if (args["--log"]->array_contains("TEST_ERROR_AVG"))
-			std::cout << "TEST_ERROR=" << errors_b[0] << std::endl;
+			std::cout << "TEST_ERROR=" << population.errors_b[population.active[0]] << std::endl;
 		if (args["--log"]->array_contains("TEST_ERROR_MAX")) 
-			std::cout << "TEST_ERROR_MAX=" << NNSpace::Common::calculate_approx_error_max(networks[0], test_set, Ltype) << std::endl;
+			std::cout << "TEST_ERROR_MAX=" << NNSpace::Common::calculate_approx_error_max(population[0], test_set, Ltype) << std::endl;
 	}
 	
 	// Write network to file
 	if (args["--output"] && args["--output"]->is_string())
-		NNSpace::Common::write_network(networks[0], args["--output"]->string());
+		NNSpace::Common::write_network(population[0], args["--output"]->string(), args["--binary"] && args["--binary"]->get_boolean());
 	
 	return 0;
 };
\ No newline at end of file
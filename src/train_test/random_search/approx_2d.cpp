@@ -25,6 +25,7 @@
  *  --test=%         Input test set
  *  --steps=%        Amount of steps for training
  *  --output=%       Output file for the network
+ *  --binary=%       Write output network in binary format
  *  --Ltype=%        L1 or L2
  *  --log=[%]        Log type (TRAIN_TIME, TRAIN_OPERATIONS, TRAIN_ITERATIONS, TEST_ERROR_AVG, TEST_ERROR_MAX)
  *
@@ -107,12 +108,18 @@ int main(int argc, const char** argv) {
 			if (args["--activator"]->string() == "BipolarSigmoid")  network.setActivator(new NNSpace::BipolarSigmoid());
 			if (args["--activator"]->string() == "ReLU")            network.setActivator(new NNSpace::ReLU()          );
 			if (args["--activator"]->string() == "TanH")            network.setActivator(new NNSpace::TanH()          );
+			if (args["--activator"]->string() == "FastSigmoid")     network.setActivator(new NNSpace::FastSigmoid()   );
+			if (args["--activator"]->string() == "FastBipolarSigmoid") network.setActivator(new NNSpace::FastBipolarSigmoid());
+			if (args["--activator"]->string() == "FastTanH")        network.setActivator(new NNSpace::FastTanH()      );
 		} else if (args["--activator"]->is_integer()) {
 			if (args["--activator"]->integer() == NNSpace::ActivatorType::LINEAR)          network.setActivator(new NNSpace::Linear()        );
 			if (args["--activator"]->integer() == NNSpace::ActivatorType::SIGMOID)         network.setActivator(new NNSpace::Sigmoid()       );
 			if (args["--activator"]->integer() == NNSpace::ActivatorType::BIPOLAR_SIGMOID) network.setActivator(new NNSpace::BipolarSigmoid());
 			if (args["--activator"]->integer() == NNSpace::ActivatorType::RELU)            network.setActivator(new NNSpace::ReLU()          );
 			if (args["--activator"]->integer() == NNSpace::ActivatorType::TANH)            network.setActivator(new NNSpace::TanH()          );
+			if (args["--activator"]->integer() == NNSpace::ActivatorType::SIGMOID_FAST)    network.setActivator(new NNSpace::FastSigmoid()   );
+			if (args["--activator"]->integer() == NNSpace::ActivatorType::BIPOLAR_SIGMOID_FAST) network.setActivator(new NNSpace::FastBipolarSigmoid());
+			if (args["--activator"]->integer() == NNSpace::ActivatorType::TANH_FAST)       network.setActivator(new NNSpace::FastTanH()      );
 		} else if (args["--activator"]->is_array()) {
 			for (int i = 0; i < args["--activator"]->array().size(); ++i) {
 				if (args["--activator"]->array()[i]->is_string()) {
@@ -121,12 +128,18 @@ int main(int argc, const char** argv) {
 					if (args["--activator"]->array()[i]->string() == "BipolarSigmoid")  network.setActivator(new NNSpace::BipolarSigmoid());
 					if (args["--activator"]->array()[i]->string() == "ReLU")            network.setActivator(new NNSpace::ReLU()          );
 					if (args["--activator"]->array()[i]->string() == "TanH")            network.setActivator(new NNSpace::TanH()          );
+					if (args["--activator"]->array()[i]->string() == "FastSigmoid")     network.setActivator(new NNSpace::FastSigmoid()   );
+					if (args["--activator"]->array()[i]->string() == "FastBipolarSigmoid") network.setActivator(new NNSpace::FastBipolarSigmoid());
+					if (args["--activator"]->array()[i]->string() == "FastTanH")        network.setActivator(new NNSpace::FastTanH()      );
 				} else if (args["--activator"]->array()[i]->is_integer()) {
 					if (args["--activator"]->array()[i]->integer() == NNSpace::ActivatorType::LINEAR)          network.setActivator(new NNSpace::Linear()        );
 					if (args["--activator"]->array()[i]->integer() == NNSpace::ActivatorType::SIGMOID)         network.setActivator(new NNSpace::Sigmoid()       );
 					if (args["--activator"]->array()[i]->integer() == NNSpace::ActivatorType::BIPOLAR_SIGMOID) network.setActivator(new NNSpace::BipolarSigmoid());
 					if (args["--activator"]->array()[i]->integer() == NNSpace::ActivatorType::RELU)            network.setActivator(new NNSpace::ReLU()          );
 					if (args["--activator"]->array()[i]->integer() == NNSpace::ActivatorType::TANH)            network.setActivator(new NNSpace::TanH()          );
+					if (args["--activator"]->array()[i]->integer() == NNSpace::ActivatorType::SIGMOID_FAST)    network.setActivator(new NNSpace::FastSigmoid()   );
+					if (args["--activator"]->array()[i]->integer() == NNSpace::ActivatorType::BIPOLAR_SIGMOID_FAST) network.setActivator(new NNSpace::FastBipolarSigmoid());
+					if (args["--activator"]->array()[i]->integer() == NNSpace::ActivatorType::TANH_FAST)       network.setActivator(new NNSpace::FastTanH()      );
 				}
 			}
 		}
@@ -305,7 +318,7 @@ int main(int argc, const char** argv) {
 	
 	// Write network to file
 	if (args["--output"] && args["--output"]->is_string())
-		NNSpace::Common::write_network(network, args["--output"]->string());
+		NNSpace::Common::write_network(network, args["--output"]->string(), args["--binary"] && args["--binary"]->get_boolean());
 	
 	return 0;
 };
\ No newline at end of file
@@ -25,6 +25,7 @@
  *  --test_offset=%  Offset value for test set
  *  --steps=%        Amount of steps for training
  *  --output=%       Output file for the network
+ *  --binary=%       Write output network in binary format
  *  --Ltype=%        L1 or L2
  *  --log=[%]        Log type (TRAIN_TIME, TRAIN_OPERATIONS, TRAIN_ITERATIONS, TEST_ERROR_AVG, TEST_ERROR_MAX)
  *
@@ -82,7 +83,7 @@ int main(int argc, const char** argv) {
 	std::string mnist_path = args["--mnist"] && args["--mnist"]->is_string() ? args["--mnist"]->string() : "mnist";
 	
 	// Read set
-	mnist::MNIST_dataset<std::vector, std::vector<uint8_t>, uint8_t> set;
+	NNSpace::MnistSet set;
 	if (!NNSpace::Common::load_mnist(set, mnist_path))
 		exit_message("Set " + mnist_path + " not found");
 	
@@ -105,6 +106,9 @@ int main(int argc, const char** argv) {
 	if (test_offset < 0 || test_size <= 0 || test_offset + test_size > set.test_images.size())
 		exit_message("Invalid test offset or size");
 	
+	// Convert testing images once
+	set.normalize_test(test_offset, test_size);
+	
 	// Generate network
 	NNSpace::MLNet network;
 	NNSpace::Common::generate_random_network(network, dimensions, wD, offsets);	
@@ -117,12 +121,18 @@ int main(int argc, const char** argv) {
 			if (args["--activator"]->string() == "BipolarSigmoid")  network.setActivator(new NNSpace::BipolarSigmoid());
 			if (args["--activator"]->string() == "ReLU")            network.setActivator(new NNSpace::ReLU()          );
 			if (args["--activator"]->string() == "TanH")            network.setActivator(new NNSpace::TanH()          );
+			if (args["--activator"]->string() == "FastSigmoid")     network.setActivator(new NNSpace::FastSigmoid()   );
+			if (args["--activator"]->string() == "FastBipolarSigmoid") network.setActivator(new NNSpace::FastBipolarSigmoid());
+			if (args["--activator"]->string() == "FastTanH")        network.setActivator(new NNSpace::FastTanH()      );
 		} else if (args["--activator"]->is_integer()) {
 			if (args["--activator"]->integer() == NNSpace::ActivatorType::LINEAR)          network.setActivator(new NNSpace::Linear()        );
 			if (args["--activator"]->integer() == NNSpace::ActivatorType::SIGMOID)         network.setActivator(new NNSpace::Sigmoid()       );
 			if (args["--activator"]->integer() == NNSpace::ActivatorType::BIPOLAR_SIGMOID) network.setActivator(new NNSpace::BipolarSigmoid());
 			if (args["--activator"]->integer() == NNSpace::ActivatorType::RELU)            network.setActivator(new NNSpace::ReLU()          );
 			if (args["--activator"]->integer() == NNSpace::ActivatorType::TANH)            network.setActivator(new NNSpace::TanH()          );
+			if (args["--activator"]->integer() == NNSpace::ActivatorType::SIGMOID_FAST)    network.setActivator(new NNSpace::FastSigmoid()   );
+			if (args["--activator"]->integer() == NNSpace::ActivatorType::BIPOLAR_SIGMOID_FAST) network.setActivator(new NNSpace::FastBipolarSigmoid());
+			if (args["--activator"]->integer() == NNSpace::ActivatorType::TANH_FAST)       network.setActivator(new NNSpace::FastTanH()      );
 		} else if (args["--activator"]->is_array()) {
 			for (int i = 0; i < args["--activator"]->array().size(); ++i) {
 				if (args["--activator"]->array()[i]->is_string()) {
@@ -131,12 +141,18 @@ int main(int argc, const char** argv) {
 					if (args["--activator"]->array()[i]->string() == "BipolarSigmoid")  network.setActivator(new NNSpace::BipolarSigmoid());
 					if (args["--activator"]->array()[i]->string() == "ReLU")            network.setActivator(new NNSpace::ReLU()          );
 					if (args["--activator"]->array()[i]->string() == "TanH")            network.setActivator(new NNSpace::TanH()          );
+					if (args["--activator"]->array()[i]->string() == "FastSigmoid")     network.setActivator(new NNSpace::FastSigmoid()   );
+					if (args["--activator"]->array()[i]->string() == "FastBipolarSigmoid") network.setActivator(new NNSpace::FastBipolarSigmoid());
+					if (args["--activator"]->array()[i]->string() == "FastTanH")        network.setActivator(new NNSpace::FastTanH()      );
 				} else if (args["--activator"]->array()[i]->is_integer()) {
 					if (args["--activator"]->array()[i]->integer() == NNSpace::ActivatorType::LINEAR)          network.setActivator(new NNSpace::Linear()        );
 					if (args["--activator"]->array()[i]->integer() == NNSpace::ActivatorType::SIGMOID)         network.setActivator(new NNSpace::Sigmoid()       );
 					if (args["--activator"]->array()[i]->integer() == NNSpace::ActivatorType::BIPOLAR_SIGMOID) network.setActivator(new NNSpace::BipolarSigmoid());
 					if (args["--activator"]->array()[i]->integer() == NNSpace::ActivatorType::RELU)            network.setActivator(new NNSpace::ReLU()          );
 					if (args["--activator"]->array()[i]->integer() == NNSpace::ActivatorType::TANH)            network.setActivator(new NNSpace::TanH()          );
+					if (args["--activator"]->array()[i]->integer() == NNSpace::ActivatorType::SIGMOID_FAST)    network.setActivator(new NNSpace::FastSigmoid()   );
+					if (args["--activator"]->array()[i]->integer() == NNSpace::ActivatorType::BIPOLAR_SIGMOID_FAST) network.setActivator(new NNSpace::FastBipolarSigmoid());
+					if (args["--activator"]->array()[i]->integer() == NNSpace::ActivatorType::TANH_FAST)       network.setActivator(new NNSpace::FastTanH()      );
 				}
 			}
 		}
@@ -277,7 +293,7 @@ int main(int argc, const char** argv) {
 	
 	// Write network to file
 	if (args["--output"] && args["--output"]->is_string())
-		NNSpace::Common::write_network(network, args["--output"]->string());
+		NNSpace::Common::write_network(network, args["--output"]->string(), args["--binary"] && args["--binary"]->get_boolean());
 	
 	return 0;
 };
\ No newline at end of file
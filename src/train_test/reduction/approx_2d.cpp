@@ -4,6 +4,7 @@
 #include <limits>
 
 #include "NetTestCommon.h"
+#include "Reduction.h"
 #include "pargs.h"
 
 /*
@@ -15,13 +16,16 @@
  *  --network=%      Path to the network
  *  --test=%         Input set
  *  --output=%       Output file for the network
+ *  --binary=%       Write output network in binary format
  *  --Ltype=%        L1 or L2
  *  --error_dev=%    Max error deviation
+ *  --prune_batch=%  Initial amount of neurons removed per iteration, adapted during reduction
+ *  --threads=%      Amount of threads used to score removal candidates
  *  --print          Enable informational printing
- *  --log=[%]        Log type (REDUCTION_TIME, REDUCTION_ITERATIONS, TEST_ERROR_AVG, TEST_ERROR_MAX, RECALC_ITERATIONS, NEURONS_REMOVED)
+ *  --log=[%]        Log type (REDUCTION_TIME, REDUCTION_ITERATIONS, TEST_ERROR_AVG, TEST_ERROR_MAX, RECALC_ITERATIONS, NEURONS_REMOVED, EVALUATIONS_SAVED)
  *
  * Make:
- * g++ src/train_test/reduction/approx_2d.cpp -o bin/reduction_approx_2d -O3 --std=c++17 -Iinclude -lstdc++fs
+ * g++ src/train_test/reduction/approx_2d.cpp -o bin/reduction_approx_2d -O3 --std=c++17 -Iinclude -lstdc++fs -pthread
  *
  * Example:
  * ./bin/reduction_approx_2d --print --error_dev=0.1 --test=data/sin_1000.mset --network=networks/approx_sin.neetwook --output=networks/approx_sin_min.neetwook --log=[REDUCTION_TIME,TEST_ERROR_AVG,TEST_ERROR_MAX,REDUCTION_ITERATIONS,TEST_MATCH,RECALC_ITERATIONS,NEURONS_REMOVED]
@@ -55,6 +59,16 @@ int main(int argc, const char** argv) {
 	
 	double error_dev = (args["--error_dev"] && args["--error_dev"]->is_real()) ? args["--error_dev"]->real() : 0.0;
 	
+	// Read threads count
+	int threads = args["--threads"] ? args["--threads"]->get_integer() : 1;
+	if (threads < 1)
+		threads = 1;
+	
+	// Read initial batch size of pruning
+	int prune_batch = args["--prune_batch"] ? args["--prune_batch"]->get_integer() : 1;
+	if (prune_batch < 1)
+		prune_batch = 1;
+	
 	// Parse print flag
 	bool print_flag = args["--print"];
 	
@@ -73,10 +87,19 @@ int main(int argc, const char** argv) {
 	unsigned long reduction_iterations = 0;
 	unsigned long recalculation_iterations = 0;
 	unsigned long neurons_removed = 0;
+	long evaluations_saved = 0;
 	
 	// Calculate initial value
 	double initial_error = NNSpace::Common::calculate_approx_error(network, test_set, Ltype);
 	
+	// Cache activations of test points
+	std::vector<double> inputs(test_set.size());
+	for (int i = 0; i < test_set.size(); ++i)
+		inputs[i] = test_set[i].first;
+	
+	NNSpace::ReductionEngine engine(network, inputs.data(), test_set.size());
+	NNSpace::ThreadPool pool(threads);
+	
 	// Looping condition
 	bool condition = 1;
 	
@@ -89,113 +112,109 @@ int main(int argc, const char** argv) {
 		
 		// Check if dimensions are size of 1
 		for (int i = 0; i < network.dimensions.size() - 2; ++i)
-			if (network.dimensions[i + 1] == 1) { 
+			if (network.activeCount(i + 1) == 1) { 
 				condition = 0;
 				break;
 			}
 		
-		// Backup weights for each neuron
-		std::vector<double> income;
-		std::vector<double> outcome;
-		double offset_store;
-		
 		// Minimal error value & neuron location
 		double min_error = std::numeric_limits<double>::max();
 		int min_error_i = -1, min_error_j = -1;
 		
-		// Calculate Ri as error value without i neuron
+		// Collect active neurons of layers that can be reduced
+		std::vector<NNSpace::ReductionEngine::Candidate> candidates;
+		for (int i = 0; i < network.dimensions.size() - 2; ++i)
+			if (network.activeCount(i + 1) != 1)
+				for (int j = 0; j < network.dimensions[i + 1]; ++j)
+					if (network.isActive(i + 1, j))
+						candidates.push_back({ i + 1, j });
+		
+		// Evaluate network without each neuron on cached activations
+		std::vector<double> scores;
+		engine.score(candidates, [&](const double* outputs) {
+			return NNSpace::Common::calculate_approx_error(outputs, network.dimensions.back(), test_set, Ltype);
+		}, scores, pool);
+		
+		// Calculate Ri as error value without i neuron, in order of candidates
 		std::vector<std::vector<double>> R(network.dimensions.size() - 2);
-		for (int i = 0; i < network.dimensions.size() - 2; ++i) {
+		for (int i = 0; i < network.dimensions.size() - 2; ++i)
 			R[i].resize(network.dimensions[i + 1]);
+		
+		for (int c = 0; c < candidates.size(); ++c) {
+			int i = candidates[c].k - 1, j = candidates[c].j;
 			
-			for (int j = 0; j < network.dimensions[i + 1]; ++j) {
-				if (network.dimensions[i + 1] == 1)
-					continue;
+			++recalculation_iterations; 
+			
+			if (print_flag)
+				std::cout << "Calculating R[" << (i + 1) << "][" << j << "], iteration: " << recalculation_iterations << std::endl;
+			
+			R[i][j] = scores[c];
+			
+			// Record maximal match value
+			if (min_error >= R[i][j]) {
+				min_error = R[i][j];
+				min_error_i = i;
+				min_error_j = j;
+			}
+		}
+		
+		if (print_flag) {
+			std::cout << "Initial error = " << initial_error << std::endl;
+			std::cout << "Iteration minimal error = " << min_error << std::endl;
+		}
+		
+		// Try to remove batch of neurons with the lowest impact at once
+		if (prune_batch > 1) {
+			std::vector<NNSpace::ReductionEngine::Candidate> batch = engine.select(candidates, scores, prune_batch, [](double a, double b) { return a < b; });
+			
+			if (batch.size() > 1) {
+				++recalculation_iterations;
 				
-				++recalculation_iterations; 
+				std::vector<double> outputs((std::size_t) engine.size() * network.dimensions.back());
+				engine.run_without(batch, outputs.data());
+				double batch_error = NNSpace::Common::calculate_approx_error(outputs.data(), network.dimensions.back(), test_set, Ltype);
 				
 				if (print_flag)
-					std::cout << "Calculating R[" << (i + 1) << "][" << j << "], iteration: " << recalculation_iterations << std::endl;
-				
-				// Backup neuron weights, remove if from the network, calculate error, than return back
-				income.resize(network.dimensions[i]);
-				for (int a = 0; a < network.dimensions[i]; ++a)
-					income[a] = network.W[i][a][j];
-				
-				outcome.resize(network.dimensions[i + 2]);
-				for (int b = 0; b < network.dimensions[i + 2]; ++b)
-					outcome[b] = network.W[i + 1][j][b];
-				
-				offset_store = network.offsets[i][j];
-				
-				// Erase
-				--network.dimensions[i + 1];
-				
-				// Remove incoming
-				for (int a = 0; a < network.dimensions[i]; ++a)
-					network.W[i][a].erase(network.W[i][a].begin() + j);
+					std::cout << "Batch of " << batch.size() << " neurons error = " << batch_error << std::endl;
 				
-				// Remove outcoming
-				network.W[i + 1].erase(network.W[i + 1].begin() + j);
-				
-				// Remove offset
-				network.offsets[i].erase(network.offsets[i].begin() + j);
-				
-				R[i][j] = NNSpace::Common::calculate_approx_error(network, test_set, Ltype);
-				
-				// Record maximal match value
-				if (min_error >= R[i][j]) {
-					min_error = R[i][j];
-					min_error_i = i;
-					min_error_j = j;
+				if (batch_error - initial_error <= error_dev) {
+					engine.remove(batch);
+					neurons_removed += batch.size();
+					
+					// Single neuron removal rescores candidates after every removed neuron
+					for (int r = 1; r < batch.size(); ++r)
+						evaluations_saved += candidates.size() - r;
+					--evaluations_saved;
+					
+					prune_batch = std::min<int>(prune_batch * 2, candidates.size());
+					continue;
 				}
 				
-				// Restore
-				++network.dimensions[i + 1];
-				
-				// Insert incoming
-				for (int a = 0; a < network.dimensions[i]; ++a)
-					network.W[i][a].insert(network.W[i][a].begin() + j, income[a]);
-				
-				// Insert outcoming
-				network.W[i + 1].insert(network.W[i + 1].begin() + j, outcome);
-				
-				// Insert offset
-				network.offsets[i].insert(network.offsets[i].begin() + j, offset_store);
+				// Rollback: batch is not removed, fall back to single neuron with smaller batch next time
+				--evaluations_saved;
+				prune_batch = std::max(1, prune_batch / 2);
 			}
 		}
 		
-		if (print_flag) {
-			std::cout << "Initial error = " << initial_error << std::endl;
-			std::cout << "Iteration minimal error = " << min_error << std::endl;
-		}
-		
 		// Remove neuron[i][j] if (initial - R[i][j]) < error_dev
 		if (min_error - initial_error <= error_dev) {
 			if (print_flag)
 				std::cout << "Iteration error += " << (initial_error - min_error) << std::endl;
 			
-			// Erase
-			--network.dimensions[min_error_i + 1];
-			
-			// Remove incoming
-			for (int a = 0; a < network.dimensions[min_error_i]; ++a)
-				network.W[min_error_i][a].erase(network.W[min_error_i][a].begin() + min_error_j);
-			
-			// Remove outcoming
-			network.W[min_error_i + 1].erase(network.W[min_error_i + 1].begin() + min_error_j);
-			
-			// Remove offset
-			network.offsets[min_error_i].erase(network.offsets[min_error_i].begin() + min_error_j);
+			// Remove neuron from network and cache
+			engine.remove(min_error_i + 1, min_error_j);
 			
 			++neurons_removed;
 			
 			if (print_flag)
-				std::cout << "Iteration new layer [" << (min_error_i + 1) << "] size: " << network.dimensions[min_error_i + 1] << std::endl;
+				std::cout << "Iteration new layer [" << (min_error_i + 1) << "] size: " << network.activeCount(min_error_i + 1) << std::endl;
 		} else 
 			condition = false;
 	}
 	
+	// Drop disabled neurons
+	network.compact();
+	
 	auto end_time = std::chrono::high_resolution_clock::now();
 	
 	// Do logging of the requested values
@@ -216,11 +235,13 @@ int main(int argc, const char** argv) {
 			std::cout << "TEST_ERROR_MAX=" << NNSpace::Common::calculate_approx_error_max(network, test_set, Ltype) << std::endl;
 		if (args["--log"]->array_contains("NEURONS_REMOVED")) 
 			std::cout << "NEURONS_REMOVED=" << neurons_removed << std::endl;
+		if (args["--log"]->array_contains("EVALUATIONS_SAVED")) 
+			std::cout << "EVALUATIONS_SAVED=" << evaluations_saved << std::endl;
 	}
 	
 	// Write network to file
 	if (args["--output"] && args["--output"]->is_string())
-		NNSpace::Common::write_network(network, args["--output"]->string());
+		NNSpace::Common::write_network(network, args["--output"]->string(), args["--binary"] && args["--binary"]->get_boolean());
 	
 	return 0;
 };
\ No newline at end of file
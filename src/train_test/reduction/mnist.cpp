@@ -4,6 +4,7 @@
 #include <limits>
 
 #include "NetTestCommon.h"
+#include "Reduction.h"
 #include "pargs.h"
 
 /*
@@ -17,13 +18,16 @@
  *  --test_size=%    Amount of digits taken from test set
  *  --test_offset=%  Offset value for test set
  *  --output=%       Output file for the network
+ *  --binary=%       Write output network in binary format
  *  --Ltype=%        L1 or L2
  *  --error_dev=%    Max error deviation
+ *  --prune_batch=%  Initial amount of neurons removed per iteration, adapted during reduction
+ *  --threads=%      Amount of threads used to score removal candidates
  *  --print          Enable informational printing
- *  --log=[%]        Log type (REDUCTION_TIME, REDUCTION_ITERATIONS, TEST_ERROR_AVG, TEST_ERROR_MAX, TEST_MATCH, RECALC_ITERATIONS, NEURONS_REMOVED)
+ *  --log=[%]        Log type (REDUCTION_TIME, REDUCTION_ITERATIONS, TEST_ERROR_AVG, TEST_ERROR_MAX, TEST_MATCH, RECALC_ITERATIONS, NEURONS_REMOVED, EVALUATIONS_SAVED)
  *
  * Make:
- * g++ src/train_test/reduction/mnist.cpp -o bin/reduction_mnist -O3 --std=c++17 -Iinclude -lstdc++fs
+ * g++ src/train_test/reduction/mnist.cpp -o bin/reduction_mnist -O3 --std=c++17 -Iinclude -lstdc++fs -pthread
  *
  * Example:
  * ./bin/reduction_mnist --test_size=1000 --print --error_dev=0.1 --mnist=data/mnist --network=networks/mnist_test.neetwook --output=networks/mnist_test_min.neetwook --log=[REDUCTION_TIME,TEST_ERROR_AVG,TEST_ERROR_MAX,REDUCTION_ITERATIONS,TEST_MATCH,RECALC_ITERATIONS,NEURONS_REMOVED]
@@ -48,7 +52,7 @@ int main(int argc, const char** argv) {
 	std::string mnist_path = args["--mnist"] && args["--mnist"]->is_string() ? args["--mnist"]->string() : "mnist";
 	
 	// Read set
-	mnist::MNIST_dataset<std::vector, std::vector<uint8_t>, uint8_t> set;
+	NNSpace::MnistSet set;
 	if (!NNSpace::Common::load_mnist(set, mnist_path))
 		exit_message("Set " + mnist_path + " not found");
 	
@@ -62,8 +66,21 @@ int main(int argc, const char** argv) {
 	if (test_offset < 0 || test_size <= 0 || test_offset + test_size > set.test_images.size())
 		exit_message("Invalid test offset or size");
 	
+	// Convert testing images once
+	set.normalize_test(test_offset, test_size);
+	
 	double error_dev = (args["--error_dev"] && args["--error_dev"]->is_real()) ? args["--error_dev"]->real() : 0.0;
 	
+	// Read threads count
+	int threads = args["--threads"] ? args["--threads"]->get_integer() : 1;
+	if (threads < 1)
+		threads = 1;
+	
+	// Read initial batch size of pruning
+	int prune_batch = args["--prune_batch"] ? args["--prune_batch"]->get_integer() : 1;
+	if (prune_batch < 1)
+		prune_batch = 1;
+	
 	// Parse print flag
 	bool print_flag = args["--print"];
 	
@@ -82,10 +99,15 @@ int main(int argc, const char** argv) {
 	unsigned long reduction_iterations = 0;
 	unsigned long recalculation_iterations = 0;
 	unsigned long neurons_removed = 0;
+	long evaluations_saved = 0;
 	
 	// Calculate initial value
 	double initial_match = NNSpace::Common::calculate_mnist_match(network, set, test_offset, test_size);
 	
+	// Cache activations of test images, test range is normalized above
+	NNSpace::ReductionEngine engine(network, set.test_inputs(test_offset, test_size, nullptr), test_size);
+	NNSpace::ThreadPool pool(threads);
+	
 	// Looping condition
 	bool condition = 1;
 	
@@ -98,113 +120,109 @@ int main(int argc, const char** argv) {
 		
 		// Check if dimensions are size of 1
 		for (int i = 0; i < network.dimensions.size() - 2; ++i)
-			if (network.dimensions[i + 1] == 1) { 
+			if (network.activeCount(i + 1) == 1) { 
 				condition = 0;
 				break;
 			}
 		
-		// Backup weights for each neuron
-		std::vector<double> income;
-		std::vector<double> outcome;
-		double offset_store;
-		
 		// Minimal error value & neuron location
 		double max_match = 0.0;
 		int max_match_i = -1, max_match_j = -1;
 		
-		// Calculate Ri as match value without i neuron
+		// Collect active neurons of layers that can be reduced
+		std::vector<NNSpace::ReductionEngine::Candidate> candidates;
+		for (int i = 0; i < network.dimensions.size() - 2; ++i)
+			if (network.activeCount(i + 1) != 1)
+				for (int j = 0; j < network.dimensions[i + 1]; ++j)
+					if (network.isActive(i + 1, j))
+						candidates.push_back({ i + 1, j });
+		
+		// Evaluate network without each neuron on cached activations
+		std::vector<double> scores;
+		engine.score(candidates, [&](const double* outputs) {
+			return NNSpace::Common::calculate_mnist_match(outputs, set, test_offset, test_size);
+		}, scores, pool);
+		
+		// Calculate Ri as match value without i neuron, in order of candidates
 		std::vector<std::vector<double>> R(network.dimensions.size() - 2);
-		for (int i = 0; i < network.dimensions.size() - 2; ++i) {
+		for (int i = 0; i < network.dimensions.size() - 2; ++i)
 			R[i].resize(network.dimensions[i + 1]);
+		
+		for (int c = 0; c < candidates.size(); ++c) {
+			int i = candidates[c].k - 1, j = candidates[c].j;
 			
-			for (int j = 0; j < network.dimensions[i + 1]; ++j) {
-				if (network.dimensions[i + 1] == 1)
-					continue;
+			++recalculation_iterations; 
+			
+			if (print_flag)
+				std::cout << "Calculating R[" << (i + 1) << "][" << j << "], iteration: " << recalculation_iterations << std::endl;
+			
+			R[i][j] = scores[c];
+			
+			// Record maximal match value
+			if (max_match <= R[i][j]) {
+				max_match = R[i][j];
+				max_match_i = i;
+				max_match_j = j;
+			}
+		}
+		
+		if (print_flag) {
+			std::cout << "Initial match = " << initial_match << std::endl;
+			std::cout << "Iteration maximal match = " << max_match << std::endl;
+		}
+		
+		// Try to remove batch of neurons with the lowest impact at once
+		if (prune_batch > 1) {
+			std::vector<NNSpace::ReductionEngine::Candidate> batch = engine.select(candidates, scores, prune_batch, [](double a, double b) { return a > b; });
+			
+			if (batch.size() > 1) {
+				++recalculation_iterations;
 				
-				++recalculation_iterations; 
+				std::vector<double> outputs((std::size_t) engine.size() * network.dimensions.back());
+				engine.run_without(batch, outputs.data());
+				double batch_match = NNSpace::Common::calculate_mnist_match(outputs.data(), set, test_offset, test_size);
 				
 				if (print_flag)
-					std::cout << "Calculating R[" << (i + 1) << "][" << j << "], iteration: " << recalculation_iterations << std::endl;
-				
-				// Backup neuron weights, remove if from the network, calculate error, than return back
-				income.resize(network.dimensions[i]);
-				for (int a = 0; a < network.dimensions[i]; ++a)
-					income[a] = network.W[i][a][j];
-				
-				outcome.resize(network.dimensions[i + 2]);
-				for (int b = 0; b < network.dimensions[i + 2]; ++b)
-					outcome[b] = network.W[i + 1][j][b];
-				
-				offset_store = network.offsets[i][j];
-				
-				// Erase
-				--network.dimensions[i + 1];
-				
-				// Remove incoming
-				for (int a = 0; a < network.dimensions[i]; ++a)
-					network.W[i][a].erase(network.W[i][a].begin() + j);
+					std::cout << "Batch of " << batch.size() << " neurons match = " << batch_match << std::endl;
 				
-				// Remove outcoming
-				network.W[i + 1].erase(network.W[i + 1].begin() + j);
-				
-				// Remove offset
-				network.offsets[i].erase(network.offsets[i].begin() + j);
-				
-				R[i][j] = NNSpace::Common::calculate_mnist_match(network, set, test_offset, test_size);
-				
-				// Record maximal match value
-				if (max_match <= R[i][j]) {
-					max_match = R[i][j];
-					max_match_i = i;
-					max_match_j = j;
+				if (initial_match - batch_match <= error_dev) {
+					engine.remove(batch);
+					neurons_removed += batch.size();
+					
+					// Single neuron removal rescores candidates after every removed neuron
+					for (int r = 1; r < batch.size(); ++r)
+						evaluations_saved += candidates.size() - r;
+					--evaluations_saved;
+					
+					prune_batch = std::min<int>(prune_batch * 2, candidates.size());
+					continue;
 				}
 				
-				// Restore
-				++network.dimensions[i + 1];
-				
-				// Insert incoming
-				for (int a = 0; a < network.dimensions[i]; ++a)
-					network.W[i][a].insert(network.W[i][a].begin() + j, income[a]);
-				
-				// Insert outcoming
-				network.W[i + 1].insert(network.W[i + 1].begin() + j, outcome);
-				
-				// Insert offset
-				network.offsets[i].insert(network.offsets[i].begin() + j, offset_store);
+				// Rollback: batch is not removed, fall back to single neuron with smaller batch next time
+				--evaluations_saved;
+				prune_batch = std::max(1, prune_batch / 2);
 			}
 		}
 		
-		if (print_flag) {
-			std::cout << "Initial match = " << initial_match << std::endl;
-			std::cout << "Iteration maximal match = " << max_match << std::endl;
-		}
-		
 		// Remove neuron[i][j] if (initial - R[i][j]) < error_dev
 		if (initial_match - max_match <= error_dev) {
 			if (print_flag)
 				std::cout << "Iteration match += " << (max_match - initial_match) << std::endl;
 			
-			// Erase
-			--network.dimensions[max_match_i + 1];
-			
-			// Remove incoming
-			for (int a = 0; a < network.dimensions[max_match_i]; ++a)
-				network.W[max_match_i][a].erase(network.W[max_match_i][a].begin() + max_match_j);
-			
-			// Remove outcoming
-			network.W[max_match_i + 1].erase(network.W[max_match_i + 1].begin() + max_match_j);
-			
-			// Remove offset
-			network.offsets[max_match_i].erase(network.offsets[max_match_i].begin() + max_match_j);
+			// Remove neuron from network and cache
+			engine.remove(max_match_i + 1, max_match_j);
 			
 			++neurons_removed;
 			
 			if (print_flag)
-				std::cout << "Iteration new layer [" << (max_match_i + 1) << "] size: " << network.dimensions[max_match_i + 1] << std::endl;
+				std::cout << "Iteration new layer [" << (max_match_i + 1) << "] size: " << network.activeCount(max_match_i + 1) << std::endl;
 		} else 
 			condition = false;
 	}
 	
+	// Drop disabled neurons
+	network.compact();
+	
 	auto end_time = std::chrono::high_resolution_clock::now();
 	
 	// Do logging of the requested values
@@ -227,11 +245,13 @@ int main(int argc, const char** argv) {
 			std::cout << "TEST_ERROR_MAX=" << NNSpace::Common::calculate_mnist_error_max(network, set, Ltype, test_offset, test_size) << std::endl;
 		if (args["--log"]->array_contains("NEURONS_REMOVED")) 
 			std::cout << "NEURONS_REMOVED=" << neurons_removed << std::endl;
+		if (args["--log"]->array_contains("EVALUATIONS_SAVED")) 
+			std::cout << "EVALUATIONS_SAVED=" << evaluations_saved << std::endl;
 	}
 	
 	// Write network to file
 	if (args["--output"] && args["--output"]->is_string())
-		NNSpace::Common::write_network(network, args["--output"]->string());
+		NNSpace::Common::write_network(network, args["--output"]->string(), args["--binary"] && args["--binary"]->get_boolean());
 	
 	return 0;
 };
\ No newline at end of file